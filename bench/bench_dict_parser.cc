@@ -0,0 +1,471 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "../include/dict_parser.h"
+#include "../include/field.h"
+#include "../include/field_handle.h"
+#include "../include/key_index.h"
+#include "../include/logging.h"
+#include "../include/static_schema.h"
+
+using namespace dict_field;
+using namespace dict_parser;
+
+// 统计堆分配次数, 用来计算 allocs_per_row.
+// 替换全部形式的全局 operator new/delete, 保证 new/delete 与 new[]/delete[] 两两配对;
+// 声明为 noinline, 否则内联到调用点后 gcc 会把 free 与 operator new 返回的指针判为不匹配 (-Wmismatched-new-delete)
+static std::atomic<uint64_t> g_num_allocs(0);
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    g_num_allocs.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+__attribute__((noinline)) void* operator new[](size_t size) { return operator new(size); }
+
+__attribute__((noinline)) void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    g_num_allocs.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size == 0 ? 1 : size);
+}
+
+__attribute__((noinline)) void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept { free(ptr); }
+__attribute__((noinline)) void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr) noexcept { free(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+__attribute__((noinline)) void operator delete(void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+__attribute__((noinline)) void operator delete[](void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+
+namespace {
+
+std::shared_ptr<Record> record_builder_func() {
+    std::shared_ptr<Record> record = std::make_shared<Record>();
+    record->add_field(std::make_shared<Field<std::string>>("name"));
+    record->add_field(std::make_shared<Field<uint32_t>>("age"));
+    record->add_field(std::make_shared<Field<int>>("height"));
+    record->add_field(std::make_shared<ArrayField<Field<std::string>>>("items"));
+
+    std::shared_ptr<NestedField> nf = std::make_shared<NestedField>("money", ",");
+    nf->add_field(std::make_shared<Field<int>>("income"));
+    nf->add_field(std::make_shared<Field<int>>("expensis"));
+
+    record->add_field(nf);
+    return record;
+}
+
+std::string make_line(int row, int array_size) {
+    static const char* const kItems[] = {"math", "cs", "physis", "chemistry", "biology"};
+    std::string line = "name_" + std::to_string(row % 1000) + "\t" + std::to_string(18 + row % 50) + "\t" +
+                       std::to_string(150 + row % 50) + "\t" + std::to_string(array_size) + ":";
+    for (int i = 0; i < array_size; i++) {
+        line += (i == 0 ? "" : ",");
+        line += kItems[(row + i) % 5];
+    }
+    line += "\t" + std::to_string(row * 7 % 100000) + "," + std::to_string(row * 3 % 100000);
+    return line;
+}
+
+// 生成一个 num_rows 行, 每行数组长度为 array_size 的合成字典, 返回文件大小
+size_t generate_dict(const std::string& filename, int num_rows, int array_size) {
+    std::ofstream ofile(filename, std::ios::out | std::ios::trunc);
+    size_t num_bytes = 0;
+    for (int i = 0; i < num_rows; i++) {
+        std::string line = make_line(i, array_size);
+        ofile << line << '\n';
+        num_bytes += line.size() + 1;
+    }
+    return num_bytes;
+}
+
+void set_counters(benchmark::State& state, uint64_t num_rows, uint64_t num_bytes, uint64_t num_allocs) {
+    state.SetItemsProcessed(num_rows);
+    state.SetBytesProcessed(num_bytes);
+    state.counters["allocs_per_row"] =
+        benchmark::Counter(num_rows == 0 ? 0 : static_cast<double>(num_allocs) / num_rows);
+}
+
+// Arg: 每行的 token 个数
+void BM_StringSplitter(benchmark::State& state) {
+    std::string line;
+    for (int i = 0; i < state.range(0); i++) {
+        line += (i == 0 ? "" : "\t") + std::string("token_") + std::to_string(i);
+    }
+    std::vector<StringPiece> items;
+    uint64_t num_rows = 0;
+    uint64_t num_allocs = g_num_allocs.load();
+    for (auto _ : state) {
+        string_splitter(StringPiece(line), "\t", items);
+        benchmark::DoNotOptimize(items.data());
+        num_rows++;
+    }
+    set_counters(state, num_rows, num_rows * line.size(), g_num_allocs.load() - num_allocs);
+}
+BENCHMARK(BM_StringSplitter)->Arg(5)->Arg(20)->Arg(100);
+
+// Args: 分隔符个数 (1 或 4), ScanMode. 输入是 100 个以 {'\t', ',', '#', ':'} 轮流分隔的 token
+void BM_SplitByChars(benchmark::State& state) {
+    static const char kDelims[] = {'\t', ',', '#', ':'};
+    std::string line;
+    for (int i = 0; i < 100; i++) {
+        line += (i == 0 ? std::string() : std::string(1, kDelims[i % 4])) + "token_" + std::to_string(i);
+    }
+    size_t num_delims = state.range(0);
+    ScanMode mode = static_cast<ScanMode>(state.range(1));
+    std::vector<StringPiece> items;
+    uint64_t num_rows = 0;
+    uint64_t num_allocs = g_num_allocs.load();
+    for (auto _ : state) {
+        split_by_chars(StringPiece(line), kDelims, num_delims, items, mode);
+        benchmark::DoNotOptimize(items.data());
+        num_rows++;
+    }
+    set_counters(state, num_rows, num_rows * line.size(), g_num_allocs.load() - num_allocs);
+}
+BENCHMARK(BM_SplitByChars)
+    ->ArgNames({"delims", "mode"})
+    ->ArgsProduct({{1, 4}, {kScanScalar, kScanSSE2, kScanAVX2}});
+
+// ParseInput: 每种类型的 parse<> 使用的输入
+template <typename T>
+struct ParseInput;
+template <>
+struct ParseInput<int> {
+    static const char* value() { return "-1234567"; }
+};
+template <>
+struct ParseInput<uint32_t> {
+    static const char* value() { return "4000000000"; }
+};
+template <>
+struct ParseInput<uint64_t> {
+    static const char* value() { return "18446744073709551615"; }
+};
+template <>
+struct ParseInput<float> {
+    static const char* value() { return "170.5"; }
+};
+template <>
+struct ParseInput<std::string> {
+    static const char* value() { return "dengyuting"; }
+};
+template <>
+struct ParseInput<InternedString> {
+    static const char* value() { return "dengyuting"; }
+};
+
+template <typename T>
+void BM_Parse(benchmark::State& state) {
+    T data;
+    StringPiece piece(ParseInput<T>::value());
+    uint64_t num_rows = 0;
+    uint64_t num_allocs = g_num_allocs.load();
+    for (auto _ : state) {
+        bool is_succ = parse(piece, data);
+        benchmark::DoNotOptimize(is_succ);
+        benchmark::DoNotOptimize(data);
+        num_rows++;
+    }
+    set_counters(state, num_rows, num_rows * piece.size(), g_num_allocs.load() - num_allocs);
+}
+BENCHMARK_TEMPLATE(BM_Parse, int);
+BENCHMARK_TEMPLATE(BM_Parse, uint32_t);
+BENCHMARK_TEMPLATE(BM_Parse, uint64_t);
+BENCHMARK_TEMPLATE(BM_Parse, float);
+BENCHMARK_TEMPLATE(BM_Parse, std::string);
+BENCHMARK_TEMPLATE(BM_Parse, InternedString);
+
+// Arg: 数组长度. 每次都用新的 ArrayField, 与 DictParser 中每行 clone 一个新 Record 的开销一致
+void BM_ArrayFieldDeserilization(benchmark::State& state) {
+    std::string inp = std::to_string(state.range(0)) + ":";
+    for (int i = 0; i < state.range(0); i++) {
+        inp += (i == 0 ? "" : ",") + std::to_string(i * 7919);
+    }
+    ArrayField<Field<uint64_t>> prototype("ids");
+    uint64_t num_rows = 0;
+    uint64_t num_allocs = g_num_allocs.load();
+    for (auto _ : state) {
+        std::shared_ptr<FieldBase> field = prototype.clone();
+        bool is_succ = field->deserilization(inp);
+        benchmark::DoNotOptimize(is_succ);
+        num_rows++;
+    }
+    set_counters(state, num_rows, num_rows * inp.size(), g_num_allocs.load() - num_allocs);
+}
+BENCHMARK(BM_ArrayFieldDeserilization)->Arg(4)->Arg(64)->Arg(1024);
+
+// Arg: 数组长度. 与 BM_ArrayFieldDeserilization 相同的输入, 元素直接解析到扁平的 vector 中
+void BM_FlatArrayFieldDeserilization(benchmark::State& state) {
+    std::string inp = std::to_string(state.range(0)) + ":";
+    for (int i = 0; i < state.range(0); i++) {
+        inp += (i == 0 ? "" : ",") + std::to_string(i * 7919);
+    }
+    FlatArrayField<uint64_t> prototype("ids");
+    uint64_t num_rows = 0;
+    uint64_t num_allocs = g_num_allocs.load();
+    for (auto _ : state) {
+        std::shared_ptr<FieldBase> field = prototype.clone();
+        bool is_succ = field->deserilization(inp);
+        benchmark::DoNotOptimize(is_succ);
+        num_rows++;
+    }
+    set_counters(state, num_rows, num_rows * inp.size(), g_num_allocs.load() - num_allocs);
+}
+BENCHMARK(BM_FlatArrayFieldDeserilization)->Arg(4)->Arg(64)->Arg(1024);
+
+void BM_NestedFieldDeserilization(benchmark::State& state) {
+    std::string inp = "yinpeng02#182#170.5";
+    NestedField prototype("people_info");
+    prototype.add_field(std::make_shared<Field<std::string>>("name"));
+    prototype.add_field(std::make_shared<Field<int>>("height"));
+    prototype.add_field(std::make_shared<Field<float>>("weight"));
+    uint64_t num_rows = 0;
+    uint64_t num_allocs = g_num_allocs.load();
+    for (auto _ : state) {
+        std::shared_ptr<FieldBase> field = prototype.clone();
+        bool is_succ = field->deserilization(inp);
+        benchmark::DoNotOptimize(is_succ);
+        num_rows++;
+    }
+    set_counters(state, num_rows, num_rows * inp.size(), g_num_allocs.load() - num_allocs);
+}
+BENCHMARK(BM_NestedFieldDeserilization);
+
+// 同一行分别用运行时 Record (每行 clone 一个新 Record) 和编译期 schema 解析
+void BM_RecordDeserilization(benchmark::State& state) {
+    std::string line = make_line(1, 3);
+    RecordTemplate record_template(record_builder_func());
+    uint64_t num_rows = 0;
+    uint64_t num_allocs = g_num_allocs.load();
+    for (auto _ : state) {
+        std::shared_ptr<Record> record = record_template.new_record();
+        bool is_succ = record->deserilization(line);
+        benchmark::DoNotOptimize(is_succ);
+        num_rows++;
+    }
+    set_counters(state, num_rows, num_rows * line.size(), g_num_allocs.load() - num_allocs);
+}
+BENCHMARK(BM_RecordDeserilization);
+
+typedef RecordSchema<Field<std::string>, Field<uint32_t>, Field<int>, ArrayField<Field<std::string>>,
+                     Nested<',', Field<int>, Field<int>>>
+    PeopleSchema;
+
+void BM_StaticSchemaParse(benchmark::State& state) {
+    std::string line = make_line(1, 3);
+    uint64_t num_rows = 0;
+    uint64_t num_allocs = g_num_allocs.load();
+    for (auto _ : state) {
+        PeopleSchema::value_type row;
+        bool is_succ = PeopleSchema::parse(line, row);
+        benchmark::DoNotOptimize(is_succ);
+        benchmark::DoNotOptimize(row);
+        num_rows++;
+    }
+    set_counters(state, num_rows, num_rows * line.size(), g_num_allocs.load() - num_allocs);
+}
+BENCHMARK(BM_StaticSchemaParse);
+
+// 按名字 + dynamic_pointer_cast 读取 field 与通过 FieldHandle 读取的对比
+void BM_FieldAccessByName(benchmark::State& state) {
+    std::shared_ptr<Record> record = record_builder_func();
+    record->deserilization(make_line(1, 3));
+    uint64_t num_rows = 0;
+    for (auto _ : state) {
+        std::string name = std::dynamic_pointer_cast<Field<std::string>>(record->get_field("name"))->data();
+        int income = std::dynamic_pointer_cast<Field<int>>(
+                         std::dynamic_pointer_cast<NestedField>(record->get_field("money"))->get_field("income"))
+                         ->data();
+        benchmark::DoNotOptimize(name);
+        benchmark::DoNotOptimize(income);
+        num_rows++;
+    }
+    set_counters(state, num_rows, 0, 0);
+}
+BENCHMARK(BM_FieldAccessByName);
+
+void BM_FieldAccessByHandle(benchmark::State& state) {
+    std::shared_ptr<Record> record = record_builder_func();
+    record->deserilization(make_line(1, 3));
+    FieldHandle<Field<std::string>> name_handle;
+    FieldHandle<Field<int>> income_handle;
+    name_handle.resolve(*record, "name");
+    income_handle.resolve(*record, "money.income");
+    uint64_t num_rows = 0;
+    for (auto _ : state) {
+        const std::string& name = name_handle.value(*record);
+        int income = income_handle.value(*record);
+        benchmark::DoNotOptimize(name.data());
+        benchmark::DoNotOptimize(income);
+        num_rows++;
+    }
+    set_counters(state, num_rows, 0, 0);
+}
+BENCHMARK(BM_FieldAccessByHandle);
+
+// Arg: 0 按字符串 key (name) 查找, 1 按整数 key (money.income) 查找. 查找和遍历结果都不分配内存
+void BM_KeyIndexLookup(benchmark::State& state) {
+    RecordTemplate record_template(record_builder_func());
+    std::vector<std::shared_ptr<Record>> records;
+    for (int row = 0; row < 100000; row++) {
+        records.push_back(record_template.new_record());
+        records.back()->deserilization(make_line(row, 3));
+    }
+    bool by_int = state.range(0) == 1;
+    uint64_t num_allocs = g_num_allocs.load();
+    std::shared_ptr<KeyIndex> index = KeyIndex::create(*record_template.prototype(), by_int ? "money.income" : "name");
+    index->reserve(records.size());
+    for (size_t row = 0; row < records.size(); row++) {
+        index->add(*records[row], row);
+    }
+    state.counters["build_allocs_per_row"] =
+        benchmark::Counter(static_cast<double>(g_num_allocs.load() - num_allocs) / records.size());
+    std::vector<std::string> names;
+    for (int i = 0; i < 1000; i++) {
+        names.push_back("name_" + std::to_string(i));
+    }
+    uint64_t num_rows = 0;
+    size_t i = 0;
+    num_allocs = g_num_allocs.load();
+    for (auto _ : state) {
+        RowRange rows = by_int ? index->equal_range(static_cast<int>(i * 7 % 100000)) : index->equal_range(names[i % 1000]);
+        size_t sum = 0;
+        for (size_t row : rows) {
+            sum += row;
+        }
+        benchmark::DoNotOptimize(sum);
+        i++;
+        num_rows++;
+    }
+    set_counters(state, num_rows, 0, g_num_allocs.load() - num_allocs);
+}
+BENCHMARK(BM_KeyIndexLookup)->Arg(0)->Arg(1);
+
+// 解析线程查找已注册的 field 类型, 只有一次原子读和一次完美哈希查找
+void BM_FieldRegistryFind(benchmark::State& state) {
+    static const char* const kNames[] = {"Field<int>", "Field<string>", "ArrayField<uint64>", "FlatArrayField<istring>"};
+    uint64_t num_rows = 0;
+    for (auto _ : state) {
+        const FieldRegistry::Entry* entry = FieldManager::instance()->registry()->find(kNames[num_rows % 4]);
+        benchmark::DoNotOptimize(entry);
+        num_rows++;
+    }
+    state.SetItemsProcessed(num_rows);
+}
+BENCHMARK(BM_FieldRegistryFind)->ThreadRange(1, 8);
+
+// Args: 词表大小. 所有线程共享同一个 StringPool, 每个线程从不同的位置开始循环驻留整个词表,
+// 词表第一次出现时插入, 之后都是查找
+void BM_StringPoolIntern(benchmark::State& state) {
+    static std::shared_ptr<StringPool> pool;
+    static std::vector<std::string> vocabulary;
+    if (state.thread_index() == 0) {
+        pool = std::make_shared<StringPool>();
+        vocabulary.clear();
+        for (int i = 0; i < state.range(0); i++) {
+            vocabulary.push_back("word_" + std::to_string(i * 7919));
+        }
+    }
+    uint64_t num_rows = 0;
+    size_t i = state.thread_index() * 7919;
+    for (auto _ : state) {
+        uint32_t id = pool->intern(vocabulary[i++ % vocabulary.size()]);
+        benchmark::DoNotOptimize(id);
+        num_rows++;
+    }
+    state.SetItemsProcessed(num_rows);
+}
+BENCHMARK(BM_StringPoolIntern)->Arg(1000)->Arg(100000)->ThreadRange(1, 64)->UseRealTime();
+
+enum ParseMode { kStream, kMmap, kColumnar, kArena, kColumnarNoPlan, kPipeline };
+
+// Args: 行数, 数组长度, 线程数, ParseMode
+void BM_ParseFile(benchmark::State& state) {
+    const int num_rows = state.range(0);
+    const int array_size = state.range(1);
+    const int num_threads = state.range(2);
+    const ParseMode mode = static_cast<ParseMode>(state.range(3));
+    std::string filename = "bench_dict_" + std::to_string(num_rows) + "_" + std::to_string(array_size) + ".txt";
+    size_t file_size = generate_dict(filename, num_rows, array_size);
+
+    uint64_t total_rows = 0;
+    uint64_t num_allocs = g_num_allocs.load();
+    for (auto _ : state) {
+        DictParser dictparser(filename, record_builder_func);
+        dictparser.set_use_mmap(mode != kStream && mode != kPipeline);
+        dictparser.set_use_pipeline(mode == kPipeline);
+        dictparser.set_columnar(mode == kColumnar || mode == kColumnarNoPlan);
+        dictparser.set_use_parse_plan(mode != kColumnarNoPlan);
+        dictparser.set_use_arena(mode == kArena);
+        dictparser.set_num_threads(num_threads);
+        if (!dictparser.parse_file() || dictparser.num_succ_parsed_line() != static_cast<uint64_t>(num_rows)) {
+            state.SkipWithError("parse_file failed");
+            break;
+        }
+        total_rows += num_rows;
+    }
+    set_counters(state, total_rows, total_rows / num_rows * file_size, g_num_allocs.load() - num_allocs);
+    remove(filename.c_str());
+}
+BENCHMARK(BM_ParseFile)
+    ->ArgNames({"rows", "array", "threads", "mode"})
+    ->Args({100000, 3, 1, kStream})
+    ->Args({100000, 3, 1, kMmap})
+    ->Args({100000, 3, 1, kColumnar})
+    ->Args({100000, 3, 1, kArena})
+    ->Args({100000, 3, 1, kColumnarNoPlan})
+    ->Args({100000, 32, 1, kMmap})
+    ->Args({1000000, 3, 1, kMmap})
+    ->Args({1000000, 3, 4, kMmap})
+    ->Args({1000000, 3, 4, kColumnar})
+    ->Args({1000000, 3, 1, kPipeline})
+    ->Args({1000000, 3, 4, kPipeline})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Args: 行数, 是否 use_arena. 只计时 clear() 释放 parsed_result_ (以及其中 Record 所在的 Arena), 解析不计时
+void BM_ParsedResultTeardown(benchmark::State& state) {
+    const int num_rows = state.range(0);
+    std::string filename = "bench_teardown_" + std::to_string(num_rows) + ".txt";
+    generate_dict(filename, num_rows, 3);
+
+    DictParser dictparser(filename, record_builder_func);
+    dictparser.set_use_mmap(true);
+    dictparser.set_use_arena(state.range(1) != 0);
+    uint64_t total_rows = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        if (!dictparser.parse_file() || dictparser.num_succ_parsed_line() != static_cast<uint64_t>(num_rows)) {
+            state.SkipWithError("parse_file failed");
+            break;
+        }
+        state.ResumeTiming();
+        dictparser.clear();
+        total_rows += num_rows;
+    }
+    state.SetItemsProcessed(total_rows);
+    remove(filename.c_str());
+}
+BENCHMARK(BM_ParsedResultTeardown)
+    ->ArgNames({"rows", "arena"})
+    ->Args({100000, 0})
+    ->Args({100000, 1})
+    ->Args({1000000, 0})
+    ->Args({1000000, 1})
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
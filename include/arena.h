@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace dict_field {
+
+// arena_skip_destructor: 为 true 时 Arena 释放 T 的对象时不调用析构函数, 直接随内存块丢弃.
+// 只有析构函数不释放 arena 之外的任何资源的类型才能特化为 true, field.h 为数值类型的 field 做了特化
+template <typename T>
+struct arena_skip_destructor : std::is_trivially_destructible<T> {};
+
+// Arena: 单调递增的内存池, 从大块内存中顺序切分, 不支持单独释放, 析构时一次性归还所有内存.
+// 通过 create 构造的对象由 Arena 负责析构: 析构时只调用登记过的析构函数, arena_skip_destructor 的类型不登记.
+// Arena 本身不是线程安全的, 并行解析时每个线程使用自己的 Arena.
+class Arena {
+   public:
+    explicit Arena(size_t block_size = 1 << 20)
+        : block_size_(block_size), cur_(nullptr), end_(nullptr), bytes_(0), cleanups_(nullptr) {}
+
+    ~Arena() {
+        for (Cleanup *cleanup = cleanups_; cleanup != nullptr; cleanup = cleanup->next) {
+            cleanup->destroy(cleanup->object);
+        }
+    }
+
+    void *allocate(size_t size, size_t align) {
+        uintptr_t cur = (reinterpret_cast<uintptr_t>(cur_) + align - 1) & ~(uintptr_t(align) - 1);
+        if (cur_ == nullptr || cur + size > reinterpret_cast<uintptr_t>(end_)) {
+            // 大对象单独占一个块, 避免浪费当前块的剩余空间
+            size_t new_block_size = size + align > block_size_ / 4 ? size + align : block_size_;
+            blocks_.push_back(Block{std::unique_ptr<char[]>(new char[new_block_size]), new_block_size});
+            char *block = blocks_.back().data.get();
+            bytes_ += new_block_size;
+            cur = (reinterpret_cast<uintptr_t>(block) + align - 1) & ~(uintptr_t(align) - 1);
+            if (new_block_size != block_size_) {
+                return reinterpret_cast<void *>(cur);
+            }
+            end_ = block + new_block_size;
+        }
+        cur_ = reinterpret_cast<char *>(cur + size);
+        return reinterpret_cast<void *>(cur);
+    }
+
+    // create: 在 arena 中构造一个 T, 对象随 Arena 一起释放
+    template <typename T, typename... Args>
+    T *create(Args &&... args) {
+        T *object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!arena_skip_destructor<T>::value) {
+            register_destructor(object);
+        }
+        return object;
+    }
+
+    // register_destructor: 登记 Arena 析构时需要调用的析构函数, 按登记的逆序调用.
+    // 用于 create 之后才开始持有 arena 之外资源的对象, 每个对象只能登记一次
+    template <typename T>
+    void register_destructor(T *object) {
+        cleanups_ = new (allocate(sizeof(Cleanup), alignof(Cleanup))) Cleanup{object, &destroy<T>, cleanups_};
+    }
+
+    // bytes_reserved: 从系统申请的总字节数
+    size_t bytes_reserved() const { return bytes_; }
+
+    // owns: ptr 是否位于本 Arena 的某个内存块中, 用于检查对象是否分配在 arena 中
+    bool owns(const void *ptr) const {
+        const char *p = static_cast<const char *>(ptr);
+        for (const auto &block : blocks_) {
+            if (p >= block.data.get() && p < block.data.get() + block.size) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+   private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    // Cleanup: 登记的析构函数, 分配在 arena 中, 串成单链表
+    struct Cleanup {
+        void *object;
+        void (*destroy)(void *);
+        Cleanup *next;
+    };
+
+    template <typename T>
+    static void destroy(void *object) {
+        static_cast<T *>(object)->~T();
+    }
+
+    Arena(const Arena &);
+    Arena &operator=(const Arena &);
+
+    size_t block_size_;
+    char *cur_;
+    char *end_;
+    size_t bytes_;
+    std::vector<Block> blocks_;
+    Cleanup *cleanups_;
+};
+
+// ArenaAllocator: 从 Arena 分配内存的 STL 分配器, deallocate 为空操作.
+// 只持有 Arena 的裸指针, 拷贝分配器没有引用计数的开销, Arena 的生命周期由使用者 (例如 DictParser 的解析结果) 管理;
+// arena 为空时退化为普通的 operator new/delete.
+template <typename T>
+class ArenaAllocator {
+   public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    ArenaAllocator() : arena_(nullptr) {}
+    ArenaAllocator(Arena *arena) : arena_(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena()) {}
+
+    T *allocate(size_t n) {
+        if (arena_ != nullptr) {
+            return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T)));
+        }
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *ptr, size_t) {
+        if (arena_ == nullptr) {
+            ::operator delete(ptr);
+        }
+    }
+
+    template <typename U>
+    struct rebind {
+        typedef ArenaAllocator<U> other;
+    };
+
+    Arena *arena() const { return arena_; }
+
+   private:
+    Arena *arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+    return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+    return !(lhs == rhs);
+}
+
+// new_field: arena 为空时同 make_shared. arena 不为空时对象由 arena 构造并拥有, 返回不带控制块的 shared_ptr
+// (use_count 为 0), 拷贝和析构都没有引用计数的原子操作; 对象只在 arena 存活期间有效
+template <typename T, typename... Args>
+std::shared_ptr<T> new_field(Arena *arena, Args &&... args) {
+    if (arena != nullptr) {
+        return std::shared_ptr<T>(std::shared_ptr<T>(), arena->create<T>(std::forward<Args>(args)...));
+    }
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+}  // namespace dict_field
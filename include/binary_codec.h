@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+
+namespace dict_field {
+
+// BinaryWriter: 把 field 的数据按二进制追加到 buffer 中, 用于字典快照
+class BinaryWriter {
+   public:
+    explicit BinaryWriter(std::string *buffer) : buffer_(buffer) {}
+
+    void write_bytes(const void *data, size_t size) { buffer_->append(static_cast<const char *>(data), size); }
+
+    template <typename T>
+    void write_pod(const T &value) {
+        write_bytes(&value, sizeof(value));
+    }
+
+   private:
+    std::string *buffer_;
+};
+
+// BinaryReader: 从一段只读内存 (通常是 mmap 的快照文件) 中顺序读取, 越界时返回 false
+class BinaryReader {
+   public:
+    BinaryReader(const char *data, size_t size) : cur_(data), end_(data + size) {}
+
+    bool read_bytes(void *data, size_t size) {
+        if (static_cast<size_t>(end_ - cur_) < size) return false;
+        memcpy(data, cur_, size);
+        cur_ += size;
+        return true;
+    }
+
+    // read_view: 不拷贝, 直接返回指向底层内存的指针
+    bool read_view(const char *&data, size_t size) {
+        if (static_cast<size_t>(end_ - cur_) < size) return false;
+        data = cur_;
+        cur_ += size;
+        return true;
+    }
+
+    template <typename T>
+    bool read_pod(T &value) {
+        return read_bytes(&value, sizeof(value));
+    }
+
+    bool eof() const { return cur_ == end_; }
+    size_t remaining() const { return end_ - cur_; }
+
+    // can_hold: 剩余的字节数是否足够容纳 count 个至少 min_bytes 字节的元素.
+    // 快照中的元素个数不可信, 按个数扩充结构或分配内存之前先用它检查
+    bool can_hold(uint64_t count, size_t min_bytes) const { return count <= remaining() / min_bytes; }
+
+   private:
+    const char *cur_;
+    const char *end_;
+};
+
+// BinaryCodec: Field<T> 中 T 的二进制编解码. 默认不支持, 算术类型和 std::string 已经特化,
+// 自定义类型如果需要写入快照, 需要自行特化 BinaryCodec. 特化中可以提供 static size_t min_bytes(),
+// 即编码一个值至少写入的字节数, 没有提供时按 1 字节计 (见 codec_min_bytes).
+template <typename T, typename Enable = void>
+struct BinaryCodec {
+    static bool write(BinaryWriter &writer, const T &value) { return false; }
+    static bool read(BinaryReader &reader, T &value) { return false; }
+};
+
+template <typename T>
+struct BinaryCodec<T, typename std::enable_if<std::is_arithmetic<T>::value>::type> {
+    static bool write(BinaryWriter &writer, const T &value) {
+        writer.write_pod(value);
+        return true;
+    }
+    static bool read(BinaryReader &reader, T &value) { return reader.read_pod(value); }
+    static size_t min_bytes() { return sizeof(T); }
+};
+
+template <>
+struct BinaryCodec<std::string> {
+    static bool write(BinaryWriter &writer, const std::string &value) {
+        writer.write_pod(static_cast<uint32_t>(value.size()));
+        writer.write_bytes(value.data(), value.size());
+        return true;
+    }
+    static bool read(BinaryReader &reader, std::string &value) {
+        uint32_t size = 0;
+        const char *data = nullptr;
+        if (!reader.read_pod(size) || !reader.read_view(data, size)) return false;
+        value.assign(data, size);
+        return true;
+    }
+    static size_t min_bytes() { return sizeof(uint32_t); }
+};
+
+template <typename Codec>
+auto codec_min_bytes_impl(int) -> decltype(Codec::min_bytes()) {
+    return Codec::min_bytes();
+}
+
+template <typename Codec>
+size_t codec_min_bytes_impl(...) {
+    return 1;
+}
+
+// codec_min_bytes: BinaryCodec<T> 编码一个值至少写入的字节数
+template <typename T>
+size_t codec_min_bytes() {
+    return codec_min_bytes_impl<BinaryCodec<T>>(0);
+}
+
+// fingerprint: 64 位 FNV-1a, 用于校验快照的 schema 与当前 schema 是否一致
+inline uint64_t fingerprint(const std::string &str) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < str.size(); i++) {
+        hash ^= static_cast<unsigned char>(str[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+}  // namespace dict_field
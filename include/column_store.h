@@ -0,0 +1,509 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "field.h"
+#include "logging.h"
+#include "string_piece.h"
+
+namespace dict_field {
+
+// ColumnBase: 列存 (struct-of-arrays) 模式下一列数据的基类.
+// 每一列直接把 token 解析到连续的类型化存储里, 不再构建 Record/Field 对象树.
+class ColumnBase {
+   public:
+    ColumnBase(const std::string &name) : name_(name) {}
+    virtual ~ColumnBase() {}
+
+    const std::string &name() const { return name_; }
+    // append: 解析一个 token 并追加为新的一行, 解析失败返回 false. 失败时本列可能残留部分数据,
+    // 由调用方通过 truncate 回滚
+    virtual bool append(const StringPiece &inp) = 0;
+    virtual size_t size() const = 0;
+    virtual void truncate(size_t num_rows) = 0;
+    // append_column: 把另一个结构相同的列追加到本列末尾, 并行解析合并结果时使用
+    virtual void append_column(const ColumnBase &other) = 0;
+
+   private:
+    std::string name_;
+};
+
+// ValueColumn: 标量列, 数据存储在一个连续的 std::vector<T> 中
+template <typename T>
+class ValueColumn final : public ColumnBase {
+   public:
+    ValueColumn(const std::string &name) : ColumnBase(name) {}
+
+    bool append(const StringPiece &inp) override {
+        values_.emplace_back();
+        if (!parse(inp, values_.back())) {
+            ParseError::set_field_type(typeid(*this));
+            return false;
+        }
+        return true;
+    }
+    size_t size() const override { return values_.size(); }
+    void truncate(size_t num_rows) override {
+        if (num_rows < values_.size()) values_.resize(num_rows);
+    }
+    void append_column(const ColumnBase &other) override {
+        const std::vector<T> &other_values = static_cast<const ValueColumn<T> &>(other).values_;
+        values_.insert(values_.end(), other_values.begin(), other_values.end());
+    }
+
+    const T &at(size_t i) const { return values_[i]; }
+    const std::vector<T> &values() const { return values_; }
+
+   private:
+    std::vector<T> values_;
+};
+
+// 字符串列: 所有字符串首尾相接存放在 bytes_ 中, 第 i 行为 [offsets_[i], offsets_[i + 1])
+template <>
+class ValueColumn<std::string> final : public ColumnBase {
+   public:
+    ValueColumn(const std::string &name) : ColumnBase(name), offsets_(1, 0) {}
+
+    bool append(const StringPiece &inp) override {
+        bytes_.append(inp.data(), inp.size());
+        offsets_.push_back(bytes_.size());
+        // 与 parse<std::string> 保持一致, 空字符串视为解析失败
+        if (inp.empty()) {
+            ParseError::set(kEmptyString);
+            ParseError::set_field_type(typeid(*this));
+            return false;
+        }
+        return true;
+    }
+    size_t size() const override { return offsets_.size() - 1; }
+    void truncate(size_t num_rows) override {
+        if (num_rows < size()) {
+            offsets_.resize(num_rows + 1);
+            bytes_.resize(offsets_.back());
+        }
+    }
+    void append_column(const ColumnBase &other) override {
+        const ValueColumn<std::string> &other_column = static_cast<const ValueColumn<std::string> &>(other);
+        uint64_t base = bytes_.size();
+        for (size_t i = 1; i < other_column.offsets_.size(); i++) {
+            offsets_.push_back(base + other_column.offsets_[i]);
+        }
+        bytes_.append(other_column.bytes_);
+    }
+
+    StringPiece at(size_t i) const { return StringPiece(bytes_.data() + offsets_[i], offsets_[i + 1] - offsets_[i]); }
+    const std::vector<uint64_t> &offsets() const { return offsets_; }
+    const std::string &bytes() const { return bytes_; }
+
+   private:
+    std::vector<uint64_t> offsets_;
+    std::string bytes_;
+};
+
+// ArrayColumn: 数组列, 所有元素存放在 values_ 中, 第 i 行的元素下标为 [offsets_[i], offsets_[i + 1])
+template <typename T>
+class ArrayColumn final : public ColumnBase {
+   public:
+    ArrayColumn(const std::string &name, const std::string &delim)
+        : ColumnBase(name), delim_(delim), offsets_(1, 0), values_(name) {}
+
+    bool append(const StringPiece &inp) override {
+        SplitBufferPool::Guard guard;
+        std::vector<StringPiece> &items = guard.buffer();
+        bool is_succ = array_splitter(inp, delim_, items);
+        if (!is_succ) {
+            ParseError::set_field_type(typeid(*this));
+        }
+        for (size_t i = 0; is_succ && i < items.size(); i++) {
+            is_succ = values_.append(items[i]);
+        }
+        offsets_.push_back(values_.size());
+        return is_succ;
+    }
+    size_t size() const override { return offsets_.size() - 1; }
+    void truncate(size_t num_rows) override {
+        if (num_rows < size()) {
+            offsets_.resize(num_rows + 1);
+        }
+        values_.truncate(offsets_.back());
+    }
+    void append_column(const ColumnBase &other) override {
+        const ArrayColumn<T> &other_column = static_cast<const ArrayColumn<T> &>(other);
+        uint64_t base = values_.size();
+        for (size_t i = 1; i < other_column.offsets_.size(); i++) {
+            offsets_.push_back(base + other_column.offsets_[i]);
+        }
+        values_.append_column(other_column.values_);
+    }
+
+    size_t array_size(size_t i) const { return offsets_[i + 1] - offsets_[i]; }
+    const std::vector<uint64_t> &offsets() const { return offsets_; }
+    const ValueColumn<T> &values() const { return values_; }
+
+   private:
+    std::string delim_;
+    std::vector<uint64_t> offsets_;
+    ValueColumn<T> values_;
+};
+
+// ComposedColumn: 对应 NestedField/Record, 自身不存数据, 只负责切分并转发给子列
+class ComposedColumn : public ColumnBase {
+   public:
+    ComposedColumn(const std::string &name, const std::string &delim) : ColumnBase(name), delim_(delim), size_(0) {}
+
+    void add_column(std::shared_ptr<ColumnBase> column) { columns_.push_back(column); }
+
+    bool append(const StringPiece &inp) override {
+        SplitBufferPool::Guard guard;
+        std::vector<StringPiece> &items = guard.buffer();
+        string_splitter(inp, delim_, items);
+        size_++;
+        if (items.size() != columns_.size()) {
+            ParseError::set(kFieldCountMismatch);
+            ParseError::set_field_type(typeid(*this));
+            return false;
+        }
+        for (size_t i = 0; i < items.size(); i++) {
+            if (!columns_[i]->append(items[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    size_t size() const override { return size_; }
+    // add_row: ParsePlan 直接写入子列时, 只需要把本列的行数加一
+    void add_row() { size_++; }
+    void truncate(size_t num_rows) override {
+        for (auto &column : columns_) {
+            column->truncate(num_rows);
+        }
+        if (num_rows < size_) size_ = num_rows;
+    }
+    void append_column(const ColumnBase &other) override {
+        const ComposedColumn &other_column = static_cast<const ComposedColumn &>(other);
+        for (size_t i = 0; i < columns_.size(); i++) {
+            columns_[i]->append_column(*other_column.columns_[i]);
+        }
+        size_ += other_column.size_;
+    }
+
+   private:
+    std::string delim_;
+    std::vector<std::shared_ptr<ColumnBase>> columns_;
+    size_t size_;
+};
+
+// ParsePlan: 把 schema 编译成一个扁平的指令序列, 每条指令包含 field 类型, 分隔符和写入的列 (slot).
+// 解析一行时按顺序执行指令, 直接把 token 写入对应类型的列, 没有虚函数调用和 ComposedColumn 的逐层转发.
+// slot 按先序遍历编号 (NestedField 先于它的子 field), 与 ColumnStore::init 生成的列一一对应,
+// 所以同一个 ParsePlan 可以用于由同一个原型初始化的所有 ColumnStore.
+class ParsePlan {
+   public:
+    enum OpCode {
+        kOpInt,
+        kOpFloat,
+        kOpUint32,
+        kOpUint64,
+        kOpString,
+        kOpIntArray,
+        kOpFloatArray,
+        kOpUint32Array,
+        kOpUint64Array,
+        kOpStringArray,
+        kOpInterned,
+        kOpInternedArray,
+        kOpNested
+    };
+
+    struct Op {
+        OpCode code;
+        // 写入的列, 见 ColumnStore::slots
+        uint32_t slot;
+        // kOpNested: 子 field 的分隔符以及紧随其后属于它的指令条数
+        char delim;
+        uint32_t num_child_ops;
+    };
+
+    ParsePlan() : delim_('\t'), num_slots_(0) {}
+
+    // compile: 支持的类型与 ColumnStore 相同, 另外要求 Record 和 NestedField 的分隔符都是单个字符.
+    // 不支持时返回 false, 调用方应退回到 ColumnStore::append_row(line)
+    bool compile(const Record &prototype) {
+        ops_.clear();
+        num_slots_ = 0;
+        if (prototype.delim().size() != 1) {
+            return false;
+        }
+        delim_ = prototype.delim()[0];
+        for (const auto &field : prototype.sub_fields()) {
+            if (!compile_field(*field)) {
+                ops_.clear();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const std::vector<Op> &ops() const { return ops_; }
+    size_t num_slots() const { return num_slots_; }
+
+    // execute: 解析一行并写入 slots 中的各列. 失败时各列可能残留部分数据, 由调用方回滚
+    bool execute(const StringPiece &line, ColumnBase *const *slots) const {
+        return execute_range(0, ops_.size(), line, delim_, slots);
+    }
+
+   private:
+    template <typename T>
+    bool try_compile_typed(const FieldBase &field, OpCode value_code, OpCode array_code, Op &op) {
+        if (dynamic_cast<const Field<T> *>(&field) != nullptr) {
+            op.code = value_code;
+            return true;
+        }
+        if (dynamic_cast<const ArrayField<Field<T>> *>(&field) != nullptr ||
+            dynamic_cast<const FlatArrayField<T> *>(&field) != nullptr) {
+            op.code = array_code;
+            return true;
+        }
+        return false;
+    }
+
+    bool compile_field(const FieldBase &field) {
+        Op op;
+        op.slot = num_slots_++;
+        op.delim = 0;
+        op.num_child_ops = 0;
+        if (try_compile_typed<int>(field, kOpInt, kOpIntArray, op) ||
+            try_compile_typed<float>(field, kOpFloat, kOpFloatArray, op) ||
+            try_compile_typed<uint32_t>(field, kOpUint32, kOpUint32Array, op) ||
+            try_compile_typed<uint64_t>(field, kOpUint64, kOpUint64Array, op) ||
+            try_compile_typed<std::string>(field, kOpString, kOpStringArray, op) ||
+            try_compile_typed<InternedString>(field, kOpInterned, kOpInternedArray, op)) {
+            ops_.push_back(op);
+            return true;
+        }
+
+        const NestedField *nested_field = dynamic_cast<const NestedField *>(&field);
+        if (nested_field == nullptr || nested_field->delim().size() != 1) {
+            return false;
+        }
+        op.code = kOpNested;
+        op.delim = nested_field->delim()[0];
+        size_t pos = ops_.size();
+        ops_.push_back(op);
+        for (const auto &sub_field : nested_field->sub_fields()) {
+            if (!compile_field(*sub_field)) {
+                return false;
+            }
+        }
+        ops_[pos].num_child_ops = ops_.size() - pos - 1;
+        return true;
+    }
+
+    // execute_range: 执行 [first, last) 之间的指令, 每条顶层指令消费 inp 中的一个 token
+    bool execute_range(size_t first, size_t last, const StringPiece &inp, char delim,
+                       ColumnBase *const *slots) const {
+        SplitBufferPool::Guard guard;
+        std::vector<StringPiece> &items = guard.buffer();
+        split_by_char(inp, delim, items);
+        size_t num_items = 0;
+        for (size_t i = first; i < last; i++) {
+            num_items++;
+            i += ops_[i].num_child_ops;
+        }
+        // 与 ComposedColumn 一致, 先检查 field 个数
+        if (items.size() != num_items) {
+            ParseError::set(kFieldCountMismatch);
+            ParseError::set_field_type(typeid(ComposedColumn));
+            return false;
+        }
+
+        const StringPiece *token = items.data();
+        for (size_t i = first; i < last; i++, token++) {
+            const Op &op = ops_[i];
+            ColumnBase *column = slots[op.slot];
+            bool is_succ = false;
+            switch (op.code) {
+                case kOpInt:
+                    is_succ = static_cast<ValueColumn<int> *>(column)->append(*token);
+                    break;
+                case kOpFloat:
+                    is_succ = static_cast<ValueColumn<float> *>(column)->append(*token);
+                    break;
+                case kOpUint32:
+                    is_succ = static_cast<ValueColumn<uint32_t> *>(column)->append(*token);
+                    break;
+                case kOpUint64:
+                    is_succ = static_cast<ValueColumn<uint64_t> *>(column)->append(*token);
+                    break;
+                case kOpString:
+                    is_succ = static_cast<ValueColumn<std::string> *>(column)->append(*token);
+                    break;
+                case kOpIntArray:
+                    is_succ = static_cast<ArrayColumn<int> *>(column)->append(*token);
+                    break;
+                case kOpFloatArray:
+                    is_succ = static_cast<ArrayColumn<float> *>(column)->append(*token);
+                    break;
+                case kOpUint32Array:
+                    is_succ = static_cast<ArrayColumn<uint32_t> *>(column)->append(*token);
+                    break;
+                case kOpUint64Array:
+                    is_succ = static_cast<ArrayColumn<uint64_t> *>(column)->append(*token);
+                    break;
+                case kOpStringArray:
+                    is_succ = static_cast<ArrayColumn<std::string> *>(column)->append(*token);
+                    break;
+                case kOpInterned:
+                    is_succ = static_cast<ValueColumn<InternedString> *>(column)->append(*token);
+                    break;
+                case kOpInternedArray:
+                    is_succ = static_cast<ArrayColumn<InternedString> *>(column)->append(*token);
+                    break;
+                case kOpNested:
+                    static_cast<ComposedColumn *>(column)->add_row();
+                    is_succ = execute_range(i + 1, i + 1 + op.num_child_ops, *token, op.delim, slots);
+                    i += op.num_child_ops;
+                    break;
+            }
+            if (!is_succ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    char delim_;
+    std::vector<Op> ops_;
+    size_t num_slots_;
+};
+
+// ColumnStore: 按 schema 列存的解析结果.
+// 叶子列按 field 名字索引, NestedField 的子列名字为 "父名字.子名字", 例如 "money.income".
+// 当前支持 Field<int/float/uint32/uint64/string/InternedString>, 对应的 ArrayField/FlatArrayField 以及 NestedField.
+// InternedString 列只存 32 位 id, 字符串内容在解析时所用的 StringPool 中.
+class ColumnStore {
+   public:
+    ColumnStore() : num_rows_(0) {}
+
+    bool init(const Record &prototype) {
+        columns_.clear();
+        slots_.clear();
+        num_rows_ = 0;
+        root_ = std::make_shared<ComposedColumn>(prototype.name_ref(), prototype.delim());
+        for (const auto &field : prototype.sub_fields()) {
+            std::shared_ptr<ColumnBase> column = make_column(*field, "");
+            if (!column) {
+                root_.reset();
+                return false;
+            }
+            root_->add_column(column);
+        }
+        return true;
+    }
+
+    // append_row: 解析一行, 失败时回滚所有列, 不会留下半行数据
+    bool append_row(const StringPiece &line) {
+        if (root_->append(line)) {
+            num_rows_++;
+            return true;
+        }
+        root_->truncate(num_rows_);
+        return false;
+    }
+
+    // append_row: 同上, 按编译好的 ParsePlan 解析. plan 必须由初始化本 ColumnStore 的原型编译得到
+    bool append_row(const StringPiece &line, const ParsePlan &plan) {
+        if (plan.execute(line, slots_.data())) {
+            root_->add_row();
+            num_rows_++;
+            return true;
+        }
+        root_->truncate(num_rows_);
+        return false;
+    }
+
+    void append_store(const ColumnStore &other) {
+        root_->append_column(*other.root_);
+        num_rows_ += other.num_rows_;
+    }
+
+    size_t num_rows() const { return num_rows_; }
+
+    std::shared_ptr<const ColumnBase> column(const std::string &name) const {
+        std::shared_ptr<const ColumnBase> retval;
+        auto iter = columns_.find(name);
+        if (iter != columns_.end()) retval = iter->second;
+        return retval;
+    }
+
+    // 例如 typed_column<ValueColumn<int>>("height"), 类型不匹配时返回 nullptr
+    template <typename ColumnT>
+    std::shared_ptr<const ColumnT> typed_column(const std::string &name) const {
+        return std::dynamic_pointer_cast<const ColumnT>(column(name));
+    }
+
+   private:
+    template <typename T>
+    bool try_make_typed_column(const FieldBase &field, const std::string &name, std::shared_ptr<ColumnBase> &column) {
+        if (dynamic_cast<const Field<T> *>(&field) != nullptr) {
+            column = std::make_shared<ValueColumn<T>>(name);
+            return true;
+        }
+        const ArrayField<Field<T>> *array_field = dynamic_cast<const ArrayField<Field<T>> *>(&field);
+        if (array_field != nullptr) {
+            column = std::make_shared<ArrayColumn<T>>(name, array_field->delim());
+            return true;
+        }
+        const FlatArrayField<T> *flat_array_field = dynamic_cast<const FlatArrayField<T> *>(&field);
+        if (flat_array_field != nullptr) {
+            column = std::make_shared<ArrayColumn<T>>(name, flat_array_field->delim());
+            return true;
+        }
+        return false;
+    }
+
+    std::shared_ptr<ColumnBase> make_column(const FieldBase &field, const std::string &prefix) {
+        std::string name = prefix + field.name_ref();
+        // 先序编号, 与 ParsePlan 的 slot 一致
+        size_t slot = slots_.size();
+        slots_.push_back(nullptr);
+        std::shared_ptr<ColumnBase> column;
+        if (try_make_typed_column<int>(field, name, column) || try_make_typed_column<float>(field, name, column) ||
+            try_make_typed_column<uint32_t>(field, name, column) ||
+            try_make_typed_column<uint64_t>(field, name, column) ||
+            try_make_typed_column<std::string>(field, name, column) ||
+            try_make_typed_column<InternedString>(field, name, column)) {
+            columns_.insert(std::make_pair(name, column));
+            slots_[slot] = column.get();
+            return column;
+        }
+
+        const NestedField *nested_field = dynamic_cast<const NestedField *>(&field);
+        if (nested_field == nullptr) {
+            LOG(ERROR) << "field [" << name << "] is not supported by ColumnStore";
+            return nullptr;
+        }
+        std::shared_ptr<ComposedColumn> composed_column = std::make_shared<ComposedColumn>(name, nested_field->delim());
+        for (const auto &sub_field : nested_field->sub_fields()) {
+            std::shared_ptr<ColumnBase> sub_column = make_column(*sub_field, name + ".");
+            if (!sub_column) {
+                return nullptr;
+            }
+            composed_column->add_column(sub_column);
+        }
+        columns_.insert(std::make_pair(name, composed_column));
+        slots_[slot] = composed_column.get();
+        return composed_column;
+    }
+
+    std::shared_ptr<ComposedColumn> root_;
+    std::unordered_map<std::string, std::shared_ptr<ColumnBase>> columns_;
+    // 除 root_ 以外的所有列, 按先序排列, 下标即 ParsePlan 中的 slot
+    std::vector<ColumnBase *> slots_;
+    size_t num_rows_;
+};
+
+}  // namespace dict_field
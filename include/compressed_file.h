@@ -0,0 +1,301 @@
+#pragma once
+
+#include <zlib.h>
+#ifdef DICT_PARSER_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "logging.h"
+#include "string_piece.h"
+
+namespace dict_parser {
+
+enum CompressionType { kNoCompression, kGzip, kZstd };
+
+// compression_type: 按文件后缀判断压缩格式, ".gz" 为 gzip, ".zst" 为 zstd
+inline CompressionType compression_type(const std::string &filename) {
+    auto ends_with = [&filename](const std::string &suffix) {
+        return filename.size() >= suffix.size() &&
+               filename.compare(filename.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (ends_with(".gz")) {
+        return kGzip;
+    }
+    if (ends_with(".zst")) {
+        return kZstd;
+    }
+    return kNoCompression;
+}
+
+// Decompressor: 流式解压一个文件, 不需要先把解压结果写到磁盘上
+class Decompressor {
+   public:
+    virtual ~Decompressor() {}
+    virtual bool open(const std::string &filename) = 0;
+    // read: 读取最多 size 字节解压后的数据, 返回读到的字节数, 0 表示文件结束, -1 表示出错
+    virtual int64_t read(char *buf, size_t size) = 0;
+
+    // create: 当前环境不支持该压缩格式时返回 nullptr
+    static std::unique_ptr<Decompressor> create(CompressionType type);
+};
+
+// GzipDecompressor: 基于 zlib 的 gzread, 支持多个 gzip member 拼接而成的文件
+class GzipDecompressor : public Decompressor {
+   public:
+    GzipDecompressor() : file_(nullptr) {}
+    ~GzipDecompressor() override {
+        if (file_ != nullptr) {
+            gzclose(file_);
+        }
+    }
+
+    bool open(const std::string &filename) override {
+        file_ = gzopen(filename.c_str(), "rb");
+        if (file_ == nullptr) {
+            LOG(ERROR) << "open file:" << filename << " error";
+            return false;
+        }
+        gzbuffer(file_, kBufferBytes);
+        return true;
+    }
+
+    int64_t read(char *buf, size_t size) override {
+        int num_bytes = gzread(file_, buf, static_cast<unsigned int>(size));
+        // 输入被截断时 gzread 返回 0, 错误只能通过 gzerror 得到
+        int errnum = Z_OK;
+        const char *message = gzerror(file_, &errnum);
+        if (num_bytes < 0 || (num_bytes == 0 && errnum != Z_OK)) {
+            LOG(ERROR) << "gzread error: " << message;
+            return -1;
+        }
+        return num_bytes;
+    }
+
+   private:
+    static const unsigned int kBufferBytes = 256 << 10;
+
+    gzFile file_;
+};
+
+#ifdef DICT_PARSER_WITH_ZSTD
+// ZstdDecompressor: 基于 ZSTD_decompressStream, 支持多个 frame 拼接而成的文件
+class ZstdDecompressor : public Decompressor {
+   public:
+    ZstdDecompressor() : file_(nullptr), stream_(nullptr), input_({nullptr, 0, 0}), frame_done_(true) {}
+    ~ZstdDecompressor() override {
+        if (stream_ != nullptr) {
+            ZSTD_freeDStream(stream_);
+        }
+        if (file_ != nullptr) {
+            fclose(file_);
+        }
+    }
+
+    bool open(const std::string &filename) override {
+        file_ = fopen(filename.c_str(), "rb");
+        if (file_ == nullptr) {
+            LOG(ERROR) << "open file:" << filename << " error";
+            return false;
+        }
+        stream_ = ZSTD_createDStream();
+        ZSTD_initDStream(stream_);
+        in_buffer_.resize(ZSTD_DStreamInSize());
+        input_.src = in_buffer_.data();
+        return true;
+    }
+
+    int64_t read(char *buf, size_t size) override {
+        ZSTD_outBuffer output = {buf, size, 0};
+        while (output.pos == 0) {
+            if (input_.pos == input_.size) {
+                input_.size = fread(&in_buffer_[0], 1, in_buffer_.size(), file_);
+                input_.pos = 0;
+                if (input_.size == 0) {
+                    if (ferror(file_) || !frame_done_) {
+                        LOG(ERROR) << "zstd input is truncated or unreadable";
+                        return -1;
+                    }
+                    return 0;
+                }
+            }
+            size_t ret = ZSTD_decompressStream(stream_, &output, &input_);
+            if (ZSTD_isError(ret)) {
+                LOG(ERROR) << "ZSTD_decompressStream error: " << ZSTD_getErrorName(ret);
+                return -1;
+            }
+            frame_done_ = ret == 0;
+        }
+        return output.pos;
+    }
+
+   private:
+    FILE *file_;
+    ZSTD_DStream *stream_;
+    std::string in_buffer_;
+    ZSTD_inBuffer input_;
+    bool frame_done_;
+};
+#endif
+
+inline std::unique_ptr<Decompressor> Decompressor::create(CompressionType type) {
+    std::unique_ptr<Decompressor> decompressor;
+    if (type == kGzip) {
+        decompressor.reset(new GzipDecompressor());
+    }
+#ifdef DICT_PARSER_WITH_ZSTD
+    if (type == kZstd) {
+        decompressor.reset(new ZstdDecompressor());
+    }
+#endif
+    return decompressor;
+}
+
+// CompressedLineReader: 后台线程解压, 调用线程切行并回调, 两者通过有界的块队列流水线执行.
+// 内存占用上界为 kMaxChunks 个 kChunkBytes 大小的块加上最长的一行
+class CompressedLineReader {
+   public:
+    CompressedLineReader() : stopped_(false), finished_(false), failed_(false) {}
+    ~CompressedLineReader() { stop(); }
+
+    bool open(const std::string &filename) {
+        CompressionType type = compression_type(filename);
+        decompressor_ = Decompressor::create(type);
+        if (!decompressor_) {
+            LOG(ERROR) << "compression format of " << filename << " is not supported";
+            return false;
+        }
+        if (!decompressor_->open(filename)) {
+            return false;
+        }
+        for (size_t i = 0; i < kMaxChunks; i++) {
+            free_chunks_.emplace_back();
+        }
+        producer_ = std::thread(&CompressedLineReader::decompress, this);
+        return true;
+    }
+
+    // for_each_line: 与 DictParser::for_each_line 相同, line_func 返回 false 时停止读取.
+    // 解压出错时返回 false
+    template <typename LineFunc>
+    bool for_each_line(LineFunc line_func) {
+        std::string partial_line;
+        std::string chunk;
+        while (pop_chunk(chunk)) {
+            const char *cur = chunk.data();
+            const char *end = cur + chunk.size();
+            bool stopped = false;
+            while (cur < end && !stopped) {
+                const char *eol = static_cast<const char *>(memchr(cur, '\n', end - cur));
+                if (eol == nullptr) {
+                    partial_line.append(cur, end - cur);
+                    break;
+                }
+                if (partial_line.empty()) {
+                    stopped = !line_func(dict_field::StringPiece(cur, eol - cur));
+                } else {
+                    partial_line.append(cur, eol - cur);
+                    stopped = !line_func(dict_field::StringPiece(partial_line));
+                    partial_line.clear();
+                }
+                cur = eol + 1;
+            }
+            push_free_chunk(chunk);
+            if (stopped) {
+                stop();
+                return true;
+            }
+        }
+        stop();
+        if (failed_) {
+            return false;
+        }
+        if (!partial_line.empty()) {
+            line_func(dict_field::StringPiece(partial_line));
+        }
+        return true;
+    }
+
+   private:
+    static const size_t kChunkBytes = 1 << 20;
+    static const size_t kMaxChunks = 4;
+
+    void decompress() {
+        std::string chunk;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this]() { return stopped_ || !free_chunks_.empty(); });
+                if (stopped_) {
+                    return;
+                }
+                chunk.swap(free_chunks_.front());
+                free_chunks_.pop_front();
+            }
+            chunk.resize(kChunkBytes);
+            int64_t num_bytes = decompressor_->read(&chunk[0], chunk.size());
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (num_bytes <= 0) {
+                failed_ = num_bytes < 0;
+                finished_ = true;
+                cond_.notify_all();
+                return;
+            }
+            chunk.resize(num_bytes);
+            full_chunks_.emplace_back();
+            full_chunks_.back().swap(chunk);
+            cond_.notify_all();
+        }
+    }
+
+    // pop_chunk: 取出下一个解压好的块, 解压结束时返回 false
+    bool pop_chunk(std::string &chunk) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this]() { return finished_ || !full_chunks_.empty(); });
+        if (full_chunks_.empty()) {
+            return false;
+        }
+        chunk.swap(full_chunks_.front());
+        full_chunks_.pop_front();
+        return true;
+    }
+
+    void push_free_chunk(std::string &chunk) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_chunks_.emplace_back();
+        free_chunks_.back().swap(chunk);
+        cond_.notify_all();
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+            cond_.notify_all();
+        }
+        if (producer_.joinable()) {
+            producer_.join();
+        }
+    }
+
+    std::unique_ptr<Decompressor> decompressor_;
+    std::thread producer_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    // 已解压待切行的块, 以及可以复用的空闲块, 两者总数为 kMaxChunks
+    std::deque<std::string> full_chunks_;
+    std::deque<std::string> free_chunks_;
+    bool stopped_;
+    bool finished_;
+    bool failed_;
+};
+
+}  // namespace dict_parser
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#include <immintrin.h>
+#define DICT_FIELD_X86_SIMD 1
+#endif
+
+#include "string_piece.h"
+
+namespace dict_field {
+
+// 向量化的分隔符扫描. 分隔符集合最多 kMaxScanDelims 个字符 (例如 {'\t', ',', '#', ':'}),
+// 一次比较 16 (SSE2) 或 32 (AVX2) 个字节, 得到分隔符位置的 bitmask 后逐位产出 token,
+// 短 token 不会因为反复调用查找函数而退化. AVX2 在运行时按 CPU 选择, 不需要 -mavx2 编译;
+// 非 x86 平台退化为标量扫描.
+static const size_t kMaxScanDelims = 4;
+
+namespace scan_internal {
+
+inline void emit_mask(uint32_t mask, size_t pos, const char *data, size_t &start, std::vector<StringPiece> &oitems) {
+    while (mask != 0) {
+        size_t end = pos + __builtin_ctz(mask);
+        if (end != start) oitems.emplace_back(data + start, end - start);
+        start = end + 1;
+        mask &= mask - 1;
+    }
+}
+
+#if defined(DICT_FIELD_X86_SIMD)
+// scan_sse2/scan_avx2: 处理 [pos, size) 中完整的 16/32 字节块, 返回第一个未处理的位置
+inline size_t scan_sse2(const char *data, size_t size, size_t pos, const char *delims, size_t num_delims,
+                        size_t &start, std::vector<StringPiece> &oitems) {
+    __m128i delim_vecs[kMaxScanDelims];
+    for (size_t i = 0; i < num_delims; i++) {
+        delim_vecs[i] = _mm_set1_epi8(delims[i]);
+    }
+    for (; pos + 16 <= size; pos += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+        __m128i hits = _mm_cmpeq_epi8(block, delim_vecs[0]);
+        for (size_t i = 1; i < num_delims; i++) {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, delim_vecs[i]));
+        }
+        emit_mask(static_cast<uint32_t>(_mm_movemask_epi8(hits)), pos, data, start, oitems);
+    }
+    return pos;
+}
+
+__attribute__((target("avx2"))) inline size_t scan_avx2(const char *data, size_t size, size_t pos,
+                                                         const char *delims, size_t num_delims, size_t &start,
+                                                         std::vector<StringPiece> &oitems) {
+    __m256i delim_vecs[kMaxScanDelims];
+    for (size_t i = 0; i < num_delims; i++) {
+        delim_vecs[i] = _mm256_set1_epi8(delims[i]);
+    }
+    for (; pos + 32 <= size; pos += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos));
+        __m256i hits = _mm256_cmpeq_epi8(block, delim_vecs[0]);
+        for (size_t i = 1; i < num_delims; i++) {
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, delim_vecs[i]));
+        }
+        emit_mask(static_cast<uint32_t>(_mm256_movemask_epi8(hits)), pos, data, start, oitems);
+    }
+    return pos;
+}
+
+inline bool cpu_has_avx2() {
+    static const bool has_avx2 = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    return has_avx2;
+}
+#endif
+
+// scan_scalar: 标量扫描 [pos, size), 并产出最后一个 token
+inline void scan_scalar(const char *data, size_t size, size_t pos, const char *delims, size_t num_delims,
+                        size_t &start, std::vector<StringPiece> &oitems) {
+    if (num_delims == 1) {
+        while (pos < size) {
+            const char *hit = static_cast<const char *>(memchr(data + pos, delims[0], size - pos));
+            if (hit == nullptr) break;
+            size_t end = hit - data;
+            if (end != start) oitems.emplace_back(data + start, end - start);
+            start = end + 1;
+            pos = start;
+        }
+    } else if (pos < size) {
+        bool is_delim[256] = {false};
+        for (size_t i = 0; i < num_delims; i++) {
+            is_delim[static_cast<unsigned char>(delims[i])] = true;
+        }
+        for (; pos < size; pos++) {
+            if (is_delim[static_cast<unsigned char>(data[pos])]) {
+                if (pos != start) oitems.emplace_back(data + start, pos - start);
+                start = pos + 1;
+            }
+        }
+    }
+    if (start < size) {
+        oitems.emplace_back(data + start, size - start);
+    }
+}
+
+}  // namespace scan_internal
+
+// ScanMode: 测试和 benchmark 用来强制选择指令集, kScanAuto 按 CPU 选择最快的实现
+enum ScanMode { kScanAuto, kScanScalar, kScanSSE2, kScanAVX2 };
+
+// split_by_chars: 按分隔符集合 delims (最多 kMaxScanDelims 个) 中任意一个字符切分 str,
+// 结果是指向 str 的切片, 空 token 会被跳过. 强制的指令集不可用时退化为可用的实现
+inline void split_by_chars(const StringPiece &str, const char *delims, size_t num_delims,
+                           std::vector<StringPiece> &oitems, ScanMode mode = kScanAuto) {
+    oitems.clear();
+    const char *data = str.data();
+    const size_t size = str.size();
+    size_t start = 0;
+    size_t pos = 0;
+    if (num_delims == 0 || num_delims > kMaxScanDelims) {
+        mode = kScanScalar;
+    }
+#if defined(DICT_FIELD_X86_SIMD)
+    if ((mode == kScanAuto || mode == kScanAVX2) && scan_internal::cpu_has_avx2()) {
+        pos = scan_internal::scan_avx2(data, size, pos, delims, num_delims, start, oitems);
+    }
+    if (mode != kScanScalar) {
+        pos = scan_internal::scan_sse2(data, size, pos, delims, num_delims, start, oitems);
+    }
+#endif
+    scan_internal::scan_scalar(data, size, pos, delims, num_delims, start, oitems);
+}
+
+// split_by_char: 按单个分隔符切分 str, 见 split_by_chars
+inline void split_by_char(const StringPiece &str, char delim, std::vector<StringPiece> &oitems) {
+    split_by_chars(str, &delim, 1, oitems);
+}
+
+}  // namespace dict_field
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cxxabi.h>
+
+#include <cstdlib>
+#include <string>
+
+namespace dict_field {
+
+// demangle: 把 typeid 的名字还原成可读的类型名, 失败时返回原始名字
+inline std::string demangle(const char *name) {
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status != 0 || demangled == nullptr) {
+        return name;
+    }
+    std::string result(demangled);
+    free(demangled);
+    return result;
+}
+
+}  // namespace dict_field
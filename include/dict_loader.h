@@ -0,0 +1,152 @@
+#pragma once
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dict_parser.h"
+#include "field.h"
+#include "logging.h"
+
+namespace dict_parser {
+
+// DictManifestEntry: 需要加载的一个字典. header_filename 不为空时由表头文件决定 schema,
+// 否则使用 record_builder_func
+struct DictManifestEntry {
+    DictManifestEntry() {}
+    DictManifestEntry(const std::string& filename, const std::string& header_filename)
+        : filename(filename), header_filename(header_filename) {}
+    DictManifestEntry(const std::string& filename,
+                      std::function<std::shared_ptr<dict_field::Record>()> record_builder_func)
+        : filename(filename), record_builder_func(record_builder_func) {}
+
+    std::string filename;
+    std::string header_filename;
+    std::function<std::shared_ptr<dict_field::Record>()> record_builder_func;
+};
+
+// DictLoadStats: 一个字典的加载结果
+struct DictLoadStats {
+    DictLoadStats() : is_succ(false), num_line(0), num_succ_parsed_line(0), num_bytes(0), elapsed_ms(0) {}
+
+    std::string filename;
+    bool is_succ;
+    uint64_t num_line;
+    uint64_t num_succ_parsed_line;
+    uint64_t num_bytes;
+    double elapsed_ms;
+};
+
+// DictLoader: 在一个固定大小的线程池上并行加载多个字典.
+// 相同的表头文件只编译一次, 对应的 DictParser 共享同一个 RecordTemplate.
+// 文件按大小从大到小分配给空闲线程, 避免最大的文件最后才开始解析而拖长总耗时.
+class DictLoader {
+   public:
+    typedef std::function<void(DictParser&)> ParserOptions;
+
+    explicit DictLoader(int num_threads = std::thread::hardware_concurrency())
+        : num_threads_(num_threads > 0 ? num_threads : 1) {}
+
+    void add(const DictManifestEntry& entry) { manifest_.push_back(entry); }
+
+    // set_parser_options: 每个 DictParser 在解析前都会调用一次, 用来设置 mmap, 列存等选项
+    void set_parser_options(const ParserOptions& parser_options) { parser_options_ = parser_options; }
+
+    // load: 加载 manifest 中的所有字典, 全部成功时返回 true. 结果和 manifest 的顺序一致
+    bool load() {
+        parsers_.assign(manifest_.size(), nullptr);
+        stats_.assign(manifest_.size(), DictLoadStats());
+
+        std::map<std::string, std::shared_ptr<const dict_field::RecordTemplate>> header_templates;
+        std::vector<std::shared_ptr<const dict_field::RecordTemplate>> record_templates(manifest_.size());
+        std::vector<size_t> order;
+        for (size_t i = 0; i < manifest_.size(); i++) {
+            const DictManifestEntry& entry = manifest_[i];
+            stats_[i].filename = entry.filename;
+            struct stat st;
+            if (stat(entry.filename.c_str(), &st) == 0) {
+                stats_[i].num_bytes = st.st_size;
+            }
+            if (entry.header_filename != "") {
+                auto iter = header_templates.find(entry.header_filename);
+                if (iter == header_templates.end()) {
+                    iter = header_templates
+                               .insert(std::make_pair(entry.header_filename,
+                                                      DictParser::compile_header_file(entry.header_filename)))
+                               .first;
+                }
+                record_templates[i] = iter->second;
+            } else if (entry.record_builder_func) {
+                record_templates[i] = std::make_shared<dict_field::RecordTemplate>(entry.record_builder_func());
+            }
+            if (!record_templates[i]) {
+                LOG(ERROR) << "no schema for " << entry.filename;
+                continue;
+            }
+            order.push_back(i);
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [this](size_t lhs, size_t rhs) { return stats_[lhs].num_bytes > stats_[rhs].num_bytes; });
+
+        std::atomic<size_t> next(0);
+        auto worker = [&]() {
+            for (size_t k = next.fetch_add(1); k < order.size(); k = next.fetch_add(1)) {
+                size_t i = order[k];
+                load_one(manifest_[i].filename, record_templates[i], i);
+            }
+        };
+        std::vector<std::thread> workers;
+        int num_workers = std::min<size_t>(num_threads_, order.size());
+        for (int i = 0; i < num_workers; i++) {
+            workers.emplace_back(worker);
+        }
+        for (auto& thread : workers) {
+            thread.join();
+        }
+
+        bool is_succ = true;
+        for (const auto& stats : stats_) {
+            is_succ = is_succ && stats.is_succ;
+        }
+        return is_succ;
+    }
+
+    // parsers: 加载失败的字典对应的位置为 nullptr
+    const std::vector<std::shared_ptr<DictParser>>& parsers() const { return parsers_; }
+    const std::vector<DictLoadStats>& stats() const { return stats_; }
+
+   private:
+    void load_one(const std::string& filename, const std::shared_ptr<const dict_field::RecordTemplate>& record_template,
+                  size_t i) {
+        auto start = std::chrono::steady_clock::now();
+        std::shared_ptr<DictParser> parser = std::make_shared<DictParser>(filename, record_template);
+        if (parser_options_) {
+            parser_options_(*parser);
+        }
+        DictLoadStats& stats = stats_[i];
+        stats.is_succ = parser->parse_file();
+        stats.num_line = parser->num_line();
+        stats.num_succ_parsed_line = parser->num_succ_parsed_line();
+        stats.elapsed_ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (stats.is_succ) {
+            parsers_[i] = parser;
+        }
+    }
+
+    int num_threads_;
+    std::vector<DictManifestEntry> manifest_;
+    ParserOptions parser_options_;
+    std::vector<std::shared_ptr<DictParser>> parsers_;
+    std::vector<DictLoadStats> stats_;
+};
+
+}  // namespace dict_parser
@@ -1,14 +1,29 @@
 
 #pragma once
 
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <functional>
+#include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "column_store.h"
+#include "compressed_file.h"
 #include "field.h"
+#include "key_index.h"
 #include "logging.h"
+#include "mapped_file.h"
+#include "parse_stats.h"
+#include "pipeline.h"
+#include "snapshot.h"
 namespace dict_parser {
 class DictParser {
    public:
@@ -17,54 +32,797 @@ class DictParser {
         std::function<std::shared_ptr<dict_field::Record>()> record_builder_func =
             []() { return std::make_shared<dict_field::Record>("record"); },
         const std::string& header_filename = "")
-        : filename_(filename), header_filename_(header_filename), record_builder_func_(record_builder_func) {
+        : filename_(filename),
+          header_filename_(header_filename),
+          num_line_(0),
+          num_succ_parsed_line_(0),
+          use_mmap_(false),
+          num_threads_(1),
+          columnar_(false),
+          use_arena_(false),
+          use_parse_plan_(true),
+          use_pipeline_(false),
+          pipeline_block_bytes_(kDefaultPipelineBlockBytes),
+          error_report_mode_(kLogEachError),
+          max_error_samples_(10),
+          string_pool_(std::make_shared<dict_field::StringPool>()),
+          collect_stats_(false),
+          log_stats_(false),
+          stats_start_allocs_(0) {
         if (header_filename_ != "") {
-            parse_header_file(field_names_);
-            record_builder_func_ = std::bind(&dict_field::FieldManager::record_builder,
-                                             dict_field::FieldManager::instance(), std::ref(field_names_));
+            parse_header_file(header_filename_, field_names_);
+            record_builder_func = std::bind(&dict_field::FieldManager::record_builder,
+                                            dict_field::FieldManager::instance(), std::ref(field_names_));
+        }
+        // record_builder_func 只在这里调用一次, 之后每一行都 clone 这个原型
+        record_template_ = std::make_shared<dict_field::RecordTemplate>(record_builder_func());
+        compile_parse_plan();
+    }
+
+    // 直接使用一个已经编译好的 schema, 多个 DictParser 之间可以共享同一个 RecordTemplate
+    DictParser(const std::string& filename, std::shared_ptr<const dict_field::RecordTemplate> record_template)
+        : filename_(filename),
+          record_template_(record_template),
+          num_line_(0),
+          num_succ_parsed_line_(0),
+          use_mmap_(false),
+          num_threads_(1),
+          columnar_(false),
+          use_arena_(false),
+          use_parse_plan_(true),
+          use_pipeline_(false),
+          pipeline_block_bytes_(kDefaultPipelineBlockBytes),
+          error_report_mode_(kLogEachError),
+          max_error_samples_(10),
+          string_pool_(std::make_shared<dict_field::StringPool>()),
+          collect_stats_(false),
+          log_stats_(false),
+          stats_start_allocs_(0) {
+        compile_parse_plan();
+    }
+
+    // use_mmap 为 true 时, parse_file 会 mmap 整个文件, 每一行以 StringPiece 的形式
+    // 直接交给 Record 反序列化, 不再为每一行拷贝一份 std::string.
+    void set_use_mmap(bool use_mmap) { use_mmap_ = use_mmap; }
+
+    // num_threads > 1 时, parse_file 会 mmap 文件并按换行符对齐切分成 num_threads 段并行解析,
+    // 解析结果按原始行序合并. 压缩文件不能切分, 只有一个线程解析 (解压在另一个线程中流水线执行).
+    void set_num_threads(int num_threads) { num_threads_ = num_threads > 0 ? num_threads : 1; }
+
+    // use_arena 为 true 时, 每个解析线程的所有 Record/Field 节点和子 field 数组都由该线程的 Arena 构造,
+    // Arena 归解析结果所有: parsed_result() 中的 Record 是不带引用计数的 shared_ptr, clone 和释放都没有原子操作,
+    // 释放解析结果时数值类型的 field 随内存块直接丢弃, 只有字符串等持有堆内存的 field 需要析构.
+    // 因此 Record 只在下一次解析, clear() 或 DictParser 析构之前有效, 不能脱离 DictParser 单独保存.
+    // 超出 std::string 短字符串优化长度的字符串内容仍然分配在堆上.
+    void set_use_arena(bool use_arena) { use_arena_ = use_arena; }
+
+    // columnar 为 true 时, 解析结果按列写入 column_store(), 不再生成 parsed_result()
+    void set_columnar(bool columnar) { columnar_ = columnar; }
+
+    // use_parse_plan 为 true (默认) 时, 列存模式按构造时由 schema 编译好的 ParsePlan 解析每一行,
+    // schema 不能编译成 ParsePlan 时自动退回到逐层转发的 ColumnStore::append_row
+    void set_use_parse_plan(bool use_parse_plan) { use_parse_plan_ = use_parse_plan; }
+
+    // use_pipeline 为 true 时, parse_file 按流水线解析: 一个 I/O 线程把文件读成以换行符对齐的大块
+    // (每块约 block_bytes 字节, 压缩文件读出的是解压后的内容), num_threads 个解析线程把块解析成一批 Record,
+    // 调用线程按原始顺序合并结果. 各阶段之间是有界的无锁队列, 读取和解析互相重叠,
+    // 适合读延迟高的网络文件系统. 各阶段耗时见 pipeline_stats(). 优先级高于 use_mmap
+    void set_use_pipeline(bool use_pipeline) { use_pipeline_ = use_pipeline; }
+    void set_pipeline_block_bytes(size_t block_bytes) {
+        if (block_bytes > 0) {
+            pipeline_block_bytes_ = block_bytes;
         }
     }
 
+    // collect_stats 为 true 时, 每次解析都统计每一行读取/切分/解析耗时的直方图, 吞吐量,
+    // 以及按 field 类型汇总的失败次数, 结果见 parse_stats(). 每行多两次取时钟的开销, 默认关闭.
+    // log_stats 为 true 时每次解析结束打一条 INFO 日志
+    void set_collect_stats(bool collect_stats, bool log_stats = false) {
+        collect_stats_ = collect_stats;
+        log_stats_ = log_stats;
+    }
+
+    // allocation_counter: 返回进程累计堆分配次数的函数, 例如分配器 (tcmalloc/jemalloc) 的统计或自定义 operator new 中的计数.
+    // 设置后 parse_stats() 中给出 allocs_per_record, 并行解析时包括所有线程的分配
+    void set_allocation_counter(const std::function<uint64_t()>& allocation_counter) {
+        allocation_counter_ = allocation_counter;
+    }
+
+    // 解析失败的行如何上报:
+    //      kLogEachError: 每一行失败都打一条 ERROR 日志 (默认)
+    //      kAggregateErrors: 解析过程中不打日志, 只按原因计数并记录前 max_error_samples 个出错行号,
+    //                        parse_file 结束时打一条汇总日志, 汇总结果见 error_summary()
+    enum ErrorReportMode { kLogEachError, kAggregateErrors };
+
+    // Field<InternedString> 等驻留字符串类型解析时写入的池, 默认每个 DictParser 有自己的池.
+    // 多个 DictParser 可以共享同一个池, 使相同的字符串在不同字典中得到相同的 id.
+    // 解析结果中的 id 只在对应的池中有意义, 读取字符串内容时需要持有这个池
+    void set_string_pool(const std::shared_ptr<dict_field::StringPool>& string_pool) { string_pool_ = string_pool; }
+    std::shared_ptr<dict_field::StringPool> string_pool() const { return string_pool_; }
+
+    void set_error_report_mode(ErrorReportMode mode) { error_report_mode_ = mode; }
+    void set_max_error_samples(size_t max_error_samples) { max_error_samples_ = max_error_samples; }
+
     bool parse_file() {
         this->clear();
+        begin_stats();
+        bool is_succ = parse_file_internal();
+        end_stats();
+        report_errors();
+        return is_succ;
+    }
 
-        std::ifstream ifile(filename_, std::ios::in);
-        if (!ifile) {
-            LOG(ERROR) << "open file:" << filename_ << " error";
+    // 流式解析: 每解析出 batch_size 条 Record 就回调一次, 解析结果不会保存到 parsed_result() 中,
+    // 内存占用只和 batch_size 有关. callback 返回 false 时提前结束解析.
+    // use_arena 时每个 batch 的 Record 只在本次 callback 期间有效.
+    // 流式解析总是单线程的, 并且忽略 columnar 设置.
+    typedef std::function<bool(const std::vector<std::shared_ptr<dict_field::Record>>&)> RecordBatchCallback;
+
+    bool parse_file_streaming(size_t batch_size, const RecordBatchCallback& callback) {
+        this->clear();
+        if (batch_size == 0) {
+            batch_size = 1;
+        }
+        begin_stats();
+        ParseContext ctx;
+        ctx.arena = new_arena();
+        init_context_stats(ctx);
+        ctx.records.reserve(batch_size);
+        bool stopped = false;
+        bool is_succ = for_each_line([&](const dict_field::StringPiece& line) {
+            parse_line(line, ctx);
+            if (ctx.records.size() >= batch_size) {
+                stopped = !callback(ctx.records);
+                ctx.records.clear();
+                // 每个 batch 使用新的 Arena, 上一个 batch 的 Record 随旧的 Arena 一起释放
+                ctx.arena = new_arena();
+                // callback 的耗时不计入下一行的读取耗时
+                ctx.last_line_end = std::chrono::steady_clock::now();
+            }
+            return !stopped;
+        });
+        if (is_succ && !stopped && !ctx.records.empty()) {
+            callback(ctx.records);
+        }
+        ctx.records.clear();
+        merge_context(ctx);
+        end_stats();
+        report_errors();
+        return is_succ;
+    }
+
+    // 增量解析: 记录上次消费到的文件偏移以及文件的 dev/inode, 文件只是在末尾追加了内容时,
+    // 只解析新追加的部分并追加到 parsed_result() (或 column_store()) 之后;
+    // 文件被截断, 被替换 (inode 变化) 或者已消费部分的末尾内容发生变化时, 退化为全量重新解析.
+    // 增量模式只消费以换行符结尾的完整行, 最后一个不完整的行留到下次再解析.
+    // 调用 parse_file/clear 之后, 下一次增量解析会全量重建.
+    bool parse_file_incremental() {
+        if (compression_type(filename_) != kNoCompression) {
+            LOG(ERROR) << "incremental parsing of compressed file " << filename_ << " is not supported";
             return false;
         }
-        std::string line;
+        MappedFile mapped_file;
+        struct stat st;
+        if (!mapped_file.open(filename_, &st)) {
+            return false;
+        }
+        const char* begin = mapped_file.data();
+        const char* end = begin + mapped_file.size();
+        bool rebuild = !incremental_.valid || incremental_.dev != st.st_dev || incremental_.ino != st.st_ino ||
+                       incremental_.offset > mapped_file.size() ||
+                       incremental_.tail.compare(0, std::string::npos,
+                                                 begin + incremental_.offset - incremental_.tail.size(),
+                                                 incremental_.tail.size()) != 0;
+        if (rebuild) {
+            this->clear();
+            if (columnar_) {
+                column_store_ = new_column_store();
+                if (!column_store_) {
+                    return false;
+                }
+            }
+        } else {
+            error_summary_.clear();
+        }
+        begin_stats();
 
-        while (getline(ifile, line)) {
-            num_line_++;
-            std::shared_ptr<dict_field::Record> record = record_builder_func_();
-            bool is_succ = record->deserilization(line);
-            if (is_succ) {
-                parsed_result_.push_back(record);
-                num_succ_parsed_line_++;
-            } else {
-                LOG(ERROR) << "parse " << line << " error";
+        const char* first = begin + incremental_.offset;
+        const char* last = first;
+        for (const char* pos = end; pos > first; pos--) {
+            if (pos[-1] == '\n') {
+                last = pos;
+                break;
             }
         }
+        parse_mapped_range(first, last);
+        end_stats();
+        report_errors();
+
+        incremental_.valid = true;
+        incremental_.dev = st.st_dev;
+        incremental_.ino = st.st_ino;
+        incremental_.offset = last - begin;
+        size_t tail_size = incremental_.offset < kIncrementalTailBytes ? incremental_.offset : kIncrementalTailBytes;
+        incremental_.tail.assign(last - tail_size, tail_size);
+        return true;
+    }
+
+    // consumed_offset: 增量解析已经消费到的文件偏移
+    uint64_t consumed_offset() const { return incremental_.valid ? incremental_.offset : 0; }
+
+    // save_snapshot: 把 parse_file 得到的 parsed_result() 写成二进制快照 (见 snapshot.h)
+    bool save_snapshot(const std::string& snapshot_filename) {
+        dict_field::StringPool::Scope scope(string_pool_.get());
+        return dict_parser::save_snapshot(snapshot_filename, *record_template_->prototype(), parsed_result_,
+                                          num_line_);
+    }
+
+    // load_snapshot: 从快照恢复 parsed_result(), 代替 parse_file. 快照的 schema 与当前 schema 不一致时返回 false
+    bool load_snapshot(const std::string& snapshot_filename) {
+        this->clear();
+        dict_field::StringPool::Scope scope(string_pool_.get());
+        if (!dict_parser::load_snapshot(snapshot_filename, *record_template_, parsed_result_, num_line_)) {
+            return false;
+        }
+        num_succ_parsed_line_ = parsed_result_.size();
+        for (auto& index : key_indexes_) {
+            rebuild_key_index(*index);
+        }
         return true;
     }
 
+    // compile_header_file: 由表头文件生成 RecordTemplate, 可以通过第二个构造函数在多个 DictParser 之间共享.
+    // 表头文件打不开时返回 nullptr
+    static std::shared_ptr<const dict_field::RecordTemplate> compile_header_file(const std::string& header_filename) {
+        std::vector<std::string> field_names;
+        if (!parse_header_file(header_filename, field_names)) {
+            return nullptr;
+        }
+        return std::make_shared<dict_field::RecordTemplate>(
+            dict_field::FieldManager::instance()->record_builder(field_names));
+    }
+
+    // add_key_index: 在 field_name 上建立哈希索引, 之后解析得到的每一条 Record 都会加入索引,
+    // 已经解析过的结果也会立即补建索引. 嵌套的子 field 用 "." 连接, 例如 "money.income".
+    // 索引只覆盖 parsed_result(), 列存模式和流式解析不建索引. field 不存在或类型不支持时返回 false
+    bool add_key_index(const std::string& field_name) {
+        if (key_index(field_name) != nullptr) {
+            return true;
+        }
+        std::shared_ptr<dict_field::KeyIndex> index =
+            dict_field::KeyIndex::create(*record_template_->prototype(), field_name);
+        if (!index) {
+            return false;
+        }
+        rebuild_key_index(*index);
+        key_indexes_.push_back(index);
+        return true;
+    }
+
+    // key_index: 没有在 field_name 上建立索引时返回 nullptr
+    const dict_field::KeyIndex* key_index(const std::string& field_name) const {
+        for (const auto& index : key_indexes_) {
+            if (index->field_name() == field_name) {
+                return index.get();
+            }
+        }
+        return nullptr;
+    }
+
+    // lookup: field_name 的值等于 key 的所有 Record 在 parsed_result() 中的下标, 按文件中的行序排列, 不分配内存.
+    // key 可以是字符串或整数, 按索引的原生类型比较 (见 KeyIndex::equal_range). 热路径上可以先用 key_index()
+    // 取得索引再直接调用 equal_range, 省去按名字查找索引. 结果在下一次解析或 clear 之前有效
+    template <typename Key>
+    dict_field::RowRange lookup(const std::string& field_name, const Key& key) const {
+        const dict_field::KeyIndex* index = key_index(field_name);
+        if (index == nullptr) {
+            LOG(ERROR) << "no key index on field [" << field_name << "]";
+            return dict_field::RowRange();
+        }
+        return index->equal_range(key);
+    }
+
     void clear() {
+        for (auto& index : key_indexes_) {
+            index->clear();
+        }
+        incremental_ = IncrementalState();
+        pipeline_stats_.clear();
+        stats_.clear();
+        error_summary_.clear();
         parsed_result_.clear();
+        arenas_.clear();
+        column_store_.reset();
         num_line_ = 0;
         num_succ_parsed_line_ = 0;
     }
 
-    uint64_t num_line() { return num_line_; }
-    uint64_t num_succ_parsed_line() { return num_succ_parsed_line_; }
+    uint64_t num_line() const { return num_line_; }
+    uint64_t num_succ_parsed_line() const { return num_succ_parsed_line_; }
+
+    const std::vector<std::shared_ptr<dict_field::Record>>& parsed_result() const { return parsed_result_; }
 
-    const std::vector<std::shared_ptr<dict_field::Record>>& parsed_result() { return parsed_result_; }
+    const dict_field::ParseErrorSummary& error_summary() const { return error_summary_; }
+
+    // 最近一次解析的统计, 没有开启 collect_stats 时全为 0
+    const ParseStats& parse_stats() const { return stats_; }
+
+    // 最近一次流水线解析的各阶段耗时, 没有使用流水线时全为 0
+    const PipelineStats& pipeline_stats() const { return pipeline_stats_; }
+
+    // 列存模式下的解析结果, 非列存模式下为空
+    std::shared_ptr<const dict_field::ColumnStore> column_store() const { return column_store_; }
+
+    std::shared_ptr<const dict_field::RecordTemplate> record_template() const { return record_template_; }
 
    private:
-    bool parse_header_file(std::vector<std::string>& field_names) {
-        std::ifstream ifile(header_filename_, std::ios::in);
+    static const size_t kDefaultPipelineBlockBytes = 4UL << 20;
+
+    // 增量解析时用已消费部分末尾的这么多字节校验文件是否被原地改写
+    static const size_t kIncrementalTailBytes = 64;
+
+    struct IncrementalState {
+        IncrementalState() : valid(false), dev(0), ino(0), offset(0) {}
+        bool valid;
+        dev_t dev;
+        ino_t ino;
+        uint64_t offset;
+        std::string tail;
+    };
+
+    bool parse_file_internal() {
+        if (columnar_) {
+            column_store_ = new_column_store();
+            if (!column_store_) {
+                return false;
+            }
+        }
+        if (use_pipeline_) {
+            return parse_pipelined();
+        }
+        if ((use_mmap_ || num_threads_ > 1) && compression_type(filename_) == kNoCompression) {
+            return parse_mapped_file();
+        }
+
+        ParseContext ctx;
+        ctx.columns = column_store_;
+        ctx.arena = new_arena();
+        init_context_stats(ctx);
+        bool is_succ = for_each_line([this, &ctx](const dict_field::StringPiece& line) {
+            parse_line(line, ctx);
+            return true;
+        });
+        merge_context(ctx);
+        return is_succ;
+    }
+
+    void report_errors() {
+        if (error_report_mode_ == kAggregateErrors && error_summary_.num_errors > 0) {
+            LOG(WARNING) << "parse " << filename_ << " done, " << error_summary_.to_string();
+        }
+    }
+
+    // 每消费这么多字节, 就把 mmap 中已经解析过的页面还给内核, 保证流式解析的内存占用有上界
+    static const size_t kMmapReleaseBytes = 64UL << 20;
+
+    // for_each_line: 逐行读取文件并回调 line_func, line_func 返回 false 时停止读取.
+    // use_mmap 时行是 mmap 区域的切片, 否则是复用同一个 std::string 缓冲区的 getline 结果
+    // 压缩文件 (.gz/.zst) 总是在后台线程中流式解压, 当前线程切行解析, 忽略 use_mmap 设置
+    template <typename LineFunc>
+    bool for_each_line(LineFunc line_func) {
+        if (compression_type(filename_) != kNoCompression) {
+            CompressedLineReader reader;
+            return reader.open(filename_) && reader.for_each_line(line_func);
+        }
+        if (use_mmap_) {
+            MappedFile mapped_file;
+            if (!mapped_file.open(filename_)) {
+                return false;
+            }
+            const char* begin = mapped_file.data();
+            const char* cur = begin;
+            const char* end = begin + mapped_file.size();
+            const char* released = begin;
+            const size_t page_size = sysconf(_SC_PAGESIZE);
+            while (cur < end) {
+                const char* eol = static_cast<const char*>(memchr(cur, '\n', end - cur));
+                if (eol == nullptr) {
+                    eol = end;
+                }
+                if (!line_func(dict_field::StringPiece(cur, eol - cur))) {
+                    break;
+                }
+                cur = eol + 1;
+                if (static_cast<size_t>(cur - released) >= kMmapReleaseBytes) {
+                    const char* release_end = begin + (cur - begin) / page_size * page_size;
+                    madvise(const_cast<char*>(released), release_end - released, MADV_DONTNEED);
+                    released = release_end;
+                }
+            }
+            return true;
+        }
+
+        std::ifstream ifile(filename_, std::ios::in);
+        if (!ifile) {
+            LOG(ERROR) << "open file:" << filename_ << " error";
+            return false;
+        }
+        std::string line;
+        while (getline(ifile, line)) {
+            if (!line_func(dict_field::StringPiece(line))) {
+                break;
+            }
+        }
+        return true;
+    }
+
+    // ParseContext: 一段输入的解析结果, 并行解析时每个线程持有一个
+    struct ParseContext {
+        ParseContext() : num_line(0), num_succ_parsed_line(0) {}
+        std::vector<std::shared_ptr<dict_field::Record>> records;
+        // 列存模式下的输出, 为空表示输出到 records
+        std::shared_ptr<dict_field::ColumnStore> columns;
+        // use_arena 时本段输入的 Record 都分配在这里, merge_context 时转交给解析结果
+        std::unique_ptr<dict_field::Arena> arena;
+        // 行号相对于本段输入的起始位置
+        dict_field::ParseErrorSummary errors;
+        uint64_t num_line;
+        uint64_t num_succ_parsed_line;
+        // collect_stats 时本段输入的统计, 以及上一行解析结束的时间 (用来计算下一行的读取耗时)
+        std::unique_ptr<ParseStats> stats;
+        std::chrono::steady_clock::time_point last_line_end;
+    };
+
+    bool parse_mapped_file() {
+        MappedFile mapped_file;
+        if (!mapped_file.open(filename_)) {
+            return false;
+        }
+        parse_mapped_range(mapped_file.data(), mapped_file.data() + mapped_file.size());
+        return true;
+    }
+
+    // parse_mapped_range: 解析一段内存中的所有行, 结果追加到当前的解析结果之后. num_threads > 1 时并行解析
+    void parse_mapped_range(const char* begin, const char* end) {
+        if (num_threads_ <= 1) {
+            ParseContext ctx;
+            ctx.columns = column_store_;
+            ctx.arena = new_arena();
+            init_context_stats(ctx);
+            parse_range(begin, end, ctx);
+            merge_context(ctx);
+            return;
+        }
+
+        // 每一段的起点都对齐到某一行的行首
+        std::vector<const char*> bounds(1, begin);
+        for (int i = 1; i < num_threads_; i++) {
+            const char* pos = begin + (end - begin) / num_threads_ * i;
+            if (pos < bounds.back()) {
+                pos = bounds.back();
+            }
+            const char* eol = pos < end ? static_cast<const char*>(memchr(pos, '\n', end - pos)) : nullptr;
+            bounds.push_back(eol == nullptr ? end : eol + 1);
+        }
+        bounds.push_back(end);
+
+        std::vector<ParseContext> contexts(num_threads_);
+        for (auto& ctx : contexts) {
+            ctx.arena = new_arena();
+            if (columnar_) {
+                ctx.columns = new_column_store();
+            }
+        }
+        // 各线程开始解析的时间相同, 第一行的读取耗时包括线程启动的时间
+        for (auto& ctx : contexts) {
+            init_context_stats(ctx);
+        }
+        std::vector<std::thread> workers;
+        for (int i = 0; i < num_threads_; i++) {
+            workers.emplace_back(&DictParser::parse_range, this, bounds[i], bounds[i + 1], std::ref(contexts[i]));
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        for (auto& ctx : contexts) {
+            merge_context(ctx);
+        }
+    }
+
+    // PipelineBlock: I/O 线程读出的一块输入, last 为 true 时通知解析线程退出
+    struct PipelineBlock {
+        PipelineBlock() : seq(0), last(false) {}
+        uint64_t seq;
+        bool last;
+        std::string data;
+    };
+
+    // PipelineBatch: 一块输入的解析结果, last 为 true 时表示发出它的解析线程已经退出
+    struct PipelineBatch {
+        PipelineBatch() : seq(0), last(false) {}
+        uint64_t seq;
+        bool last;
+        ParseContext ctx;
+    };
+
+    static double elapsed_ms(const std::chrono::steady_clock::time_point& start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool parse_pipelined() {
+        auto start = std::chrono::steady_clock::now();
+        BlockReader reader;
+        if (!reader.open(filename_)) {
+            return false;
+        }
+        const int num_workers = num_threads_;
+        // 每个解析线程最多有两块在排队, 内存占用的上界约为 4 * num_threads * block_bytes
+        BoundedQueue<std::unique_ptr<PipelineBlock>> blocks(2 * num_workers);
+        BoundedQueue<std::unique_ptr<PipelineBatch>> batches(2 * num_workers);
+        std::atomic<bool> read_failed(false);
+        PipelineStats read_stats;
+        std::vector<PipelineStats> parse_stats(num_workers);
+
+        std::thread io_thread([&]() {
+            for (uint64_t seq = 0;; seq++) {
+                auto read_start = std::chrono::steady_clock::now();
+                std::unique_ptr<PipelineBlock> block(new PipelineBlock());
+                block->seq = seq;
+                int64_t num_bytes = reader.next(block->data, pipeline_block_bytes_);
+                read_stats.read_ms += elapsed_ms(read_start);
+                if (num_bytes <= 0) {
+                    read_failed = num_bytes < 0;
+                    break;
+                }
+                read_stats.num_blocks++;
+                read_stats.num_bytes += num_bytes;
+                auto wait_start = std::chrono::steady_clock::now();
+                blocks.push(block);
+                read_stats.read_wait_ms += elapsed_ms(wait_start);
+            }
+            for (int i = 0; i < num_workers; i++) {
+                std::unique_ptr<PipelineBlock> block(new PipelineBlock());
+                block->last = true;
+                blocks.push(block);
+            }
+        });
+
+        std::vector<std::thread> workers;
+        for (int i = 0; i < num_workers; i++) {
+            workers.emplace_back([&, i]() {
+                PipelineStats& stats = parse_stats[i];
+                while (true) {
+                    auto wait_start = std::chrono::steady_clock::now();
+                    std::unique_ptr<PipelineBlock> block;
+                    blocks.pop(block);
+                    stats.parse_wait_ms += elapsed_ms(wait_start);
+                    std::unique_ptr<PipelineBatch> batch(new PipelineBatch());
+                    batch->seq = block->seq;
+                    batch->last = block->last;
+                    if (!block->last) {
+                        auto parse_start = std::chrono::steady_clock::now();
+                        batch->ctx.arena = new_arena();
+                        if (columnar_) {
+                            batch->ctx.columns = new_column_store();
+                        }
+                        init_context_stats(batch->ctx);
+                        const char* begin = block->data.data();
+                        parse_range(begin, begin + block->data.size(), batch->ctx);
+                        block.reset();
+                        stats.parse_ms += elapsed_ms(parse_start);
+                    }
+                    wait_start = std::chrono::steady_clock::now();
+                    bool last = batch->last;
+                    batches.push(batch);
+                    stats.parse_wait_ms += elapsed_ms(wait_start);
+                    if (last) {
+                        return;
+                    }
+                }
+            });
+        }
+
+        // 解析结果可能乱序到达, 按块的序号依次合并
+        std::map<uint64_t, std::unique_ptr<PipelineBatch>> pending;
+        uint64_t next_seq = 0;
+        for (int num_finished = 0; num_finished < num_workers;) {
+            auto wait_start = std::chrono::steady_clock::now();
+            std::unique_ptr<PipelineBatch> batch;
+            batches.pop(batch);
+            pipeline_stats_.collect_wait_ms += elapsed_ms(wait_start);
+            if (batch->last) {
+                num_finished++;
+                continue;
+            }
+            auto collect_start = std::chrono::steady_clock::now();
+            pending[batch->seq] = std::move(batch);
+            for (auto iter = pending.begin(); iter != pending.end() && iter->first == next_seq; next_seq++) {
+                merge_context(iter->second->ctx);
+                iter = pending.erase(iter);
+            }
+            pipeline_stats_.collect_ms += elapsed_ms(collect_start);
+        }
+        io_thread.join();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        pipeline_stats_.num_blocks = read_stats.num_blocks;
+        pipeline_stats_.num_bytes = read_stats.num_bytes;
+        pipeline_stats_.num_parse_threads = num_workers;
+        pipeline_stats_.read_ms = read_stats.read_ms;
+        pipeline_stats_.read_wait_ms = read_stats.read_wait_ms;
+        for (const auto& stats : parse_stats) {
+            pipeline_stats_.parse_ms += stats.parse_ms;
+            pipeline_stats_.parse_wait_ms += stats.parse_wait_ms;
+        }
+        pipeline_stats_.elapsed_ms = elapsed_ms(start);
+        return !read_failed;
+    }
+
+    // 与 getline 的语义保持一致: 最后一行没有换行符也算一行, 文件末尾的换行符不会多出一个空行
+    void parse_range(const char* cur, const char* end, ParseContext& ctx) {
+        while (cur < end) {
+            const char* eol = static_cast<const char*>(memchr(cur, '\n', end - cur));
+            if (eol == nullptr) {
+                eol = end;
+            }
+            parse_line(dict_field::StringPiece(cur, eol - cur), ctx);
+            cur = eol + 1;
+        }
+    }
+
+    void parse_line(const dict_field::StringPiece& line, ParseContext& ctx) {
+        ctx.num_line++;
+        dict_field::StringPool::Scope scope(string_pool_.get());
+        dict_field::ParseError::reset();
+        std::chrono::steady_clock::time_point start;
+        uint64_t split_ns = 0;
+        if (ctx.stats) {
+            start = std::chrono::steady_clock::now();
+        }
+        bool is_succ = false;
+        if (ctx.columns) {
+            is_succ = use_parse_plan_ && parse_plan_ ? ctx.columns->append_row(line, *parse_plan_)
+                                                     : ctx.columns->append_row(line);
+        } else {
+            std::shared_ptr<dict_field::Record> record = record_template_->new_record(ctx.arena.get());
+            is_succ = ctx.stats ? record->deserilization(line, split_ns) : record->deserilization(line);
+            if (is_succ) {
+                ctx.records.push_back(record);
+            }
+        }
+        if (ctx.stats) {
+            record_line_stats(line, start, split_ns, is_succ, ctx);
+        }
+        if (is_succ) {
+            ctx.num_succ_parsed_line++;
+            return;
+        }
+        dict_field::ParseErrorCode code = dict_field::ParseError::take();
+        ctx.errors.add(code, ctx.num_line, max_error_samples_);
+        if (error_report_mode_ == kLogEachError) {
+            LOG(ERROR) << "parse " << line << " error: " << dict_field::parse_error_name(code);
+        }
+    }
+
+    static uint64_t elapsed_ns(const std::chrono::steady_clock::time_point& start,
+                               const std::chrono::steady_clock::time_point& end) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    }
+
+    void init_context_stats(ParseContext& ctx) {
+        if (collect_stats_) {
+            ctx.stats.reset(new ParseStats());
+            ctx.last_line_end = std::chrono::steady_clock::now();
+        }
+    }
+
+    // record_line_stats: 出错时必须在 ParseError::reset 之前调用, 才能取到失败的 field 类型
+    void record_line_stats(const dict_field::StringPiece& line, const std::chrono::steady_clock::time_point& start,
+                           uint64_t split_ns, bool is_succ, ParseContext& ctx) {
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        ParseStats& stats = *ctx.stats;
+        stats.read_ns.record(elapsed_ns(ctx.last_line_end, start));
+        if (!ctx.columns) {
+            stats.split_ns.record(split_ns);
+        }
+        stats.parse_ns.record(elapsed_ns(start, end));
+        stats.num_lines++;
+        stats.num_bytes += line.size() + 1;
+        if (is_succ) {
+            stats.num_records++;
+        } else {
+            stats.add_field_type_error(dict_field::ParseError::take_field_type());
+        }
+        ctx.last_line_end = end;
+    }
+
+    void begin_stats() {
+        stats_.clear();
+        if (!collect_stats_) {
+            return;
+        }
+        stats_start_ = std::chrono::steady_clock::now();
+        stats_start_allocs_ = allocation_counter_ ? allocation_counter_() : 0;
+    }
+
+    void end_stats() {
+        if (!collect_stats_) {
+            return;
+        }
+        stats_.elapsed_ms = elapsed_ms(stats_start_);
+        if (allocation_counter_) {
+            stats_.has_alloc_counter = true;
+            stats_.num_allocs = allocation_counter_() - stats_start_allocs_;
+        }
+        if (log_stats_) {
+            LOG(INFO) << "parse " << filename_ << " stats: " << stats_.to_string();
+        }
+    }
+
+    void merge_context(ParseContext& ctx) {
+        if (ctx.stats) {
+            stats_.merge(*ctx.stats);
+            ctx.stats.reset();
+        }
+        error_summary_.merge(ctx.errors, num_line_, max_error_samples_);
+        ctx.errors.clear();
+        num_line_ += ctx.num_line;
+        num_succ_parsed_line_ += ctx.num_succ_parsed_line;
+        for (auto& index : key_indexes_) {
+            for (size_t i = 0; i < ctx.records.size(); i++) {
+                index->add(*ctx.records[i], parsed_result_.size() + i);
+            }
+        }
+        if (parsed_result_.empty()) {
+            parsed_result_.swap(ctx.records);
+        } else {
+            parsed_result_.insert(parsed_result_.end(), ctx.records.begin(), ctx.records.end());
+        }
+        ctx.records.clear();
+        if (ctx.arena) {
+            arenas_.push_back(std::move(ctx.arena));
+        }
+        if (ctx.columns && ctx.columns != column_store_) {
+            column_store_->append_store(*ctx.columns);
+            ctx.columns.reset();
+        }
+    }
+
+    void rebuild_key_index(dict_field::KeyIndex& index) {
+        index.clear();
+        index.reserve(parsed_result_.size());
+        for (size_t i = 0; i < parsed_result_.size(); i++) {
+            index.add(*parsed_result_[i], i);
+        }
+    }
+
+    std::unique_ptr<dict_field::Arena> new_arena() {
+        return std::unique_ptr<dict_field::Arena>(use_arena_ && !columnar_ ? new dict_field::Arena() : nullptr);
+    }
+
+    std::shared_ptr<dict_field::ColumnStore> new_column_store() {
+        std::shared_ptr<dict_field::ColumnStore> column_store = std::make_shared<dict_field::ColumnStore>();
+        if (!column_store->init(*record_template_->prototype())) {
+            LOG(ERROR) << "schema of " << filename_ << " can not be stored in columns";
+            return nullptr;
+        }
+        return column_store;
+    }
+
+    // compile_parse_plan: schema 只在构造时编译一次, 之后所有 ColumnStore 共享同一个 ParsePlan
+    void compile_parse_plan() {
+        std::shared_ptr<dict_field::ParsePlan> parse_plan = std::make_shared<dict_field::ParsePlan>();
+        if (parse_plan->compile(*record_template_->prototype())) {
+            parse_plan_ = parse_plan;
+        }
+    }
+
+    static bool parse_header_file(const std::string& header_filename, std::vector<std::string>& field_names) {
+        std::ifstream ifile(header_filename, std::ios::in);
         if (!ifile) {
-            LOG(ERROR) << "open file:" << header_filename_ << " error";
+            LOG(ERROR) << "open file:" << header_filename << " error";
             return false;
         }
         std::string line;
@@ -78,9 +836,33 @@ class DictParser {
     std::string filename_;
     std::string header_filename_;
     std::vector<std::string> field_names_;
-    std::function<std::shared_ptr<dict_field::Record>()> record_builder_func_;
+    std::shared_ptr<const dict_field::RecordTemplate> record_template_;
+    std::shared_ptr<const dict_field::ParsePlan> parse_plan_;
+    // use_arena 时 parsed_result_ 中的 Record 所在的 Arena, 声明在 parsed_result_ 之前, 析构时后释放
+    std::vector<std::unique_ptr<dict_field::Arena>> arenas_;
     std::vector<std::shared_ptr<dict_field::Record>> parsed_result_;
     uint64_t num_line_;
     uint64_t num_succ_parsed_line_;
+    std::shared_ptr<dict_field::ColumnStore> column_store_;
+    bool use_mmap_;
+    int num_threads_;
+    bool columnar_;
+    bool use_arena_;
+    bool use_parse_plan_;
+    bool use_pipeline_;
+    size_t pipeline_block_bytes_;
+    ErrorReportMode error_report_mode_;
+    size_t max_error_samples_;
+    dict_field::ParseErrorSummary error_summary_;
+    std::shared_ptr<dict_field::StringPool> string_pool_;
+    PipelineStats pipeline_stats_;
+    bool collect_stats_;
+    bool log_stats_;
+    std::function<uint64_t()> allocation_counter_;
+    ParseStats stats_;
+    std::chrono::steady_clock::time_point stats_start_;
+    uint64_t stats_start_allocs_;
+    IncrementalState incremental_;
+    std::vector<std::shared_ptr<dict_field::KeyIndex>> key_indexes_;
 };
 }  // namespace dict_parser
\ No newline at end of file
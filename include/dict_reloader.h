@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "dict_parser.h"
+#include "logging.h"
+
+namespace dict_parser {
+
+// DictVersion: 字典的一个已发布版本, 发布之后只读
+class DictVersion {
+   public:
+    DictVersion(uint64_t version, std::shared_ptr<const DictParser> dict) : version_(version), dict_(dict) {}
+
+    uint64_t version() const { return version_; }
+    const DictParser& dict() const { return *dict_; }
+
+   private:
+    uint64_t version_;
+    std::shared_ptr<const DictParser> dict_;
+};
+
+// DictReloader: 双缓冲的字典热加载.
+// reload 在后台用一个新的 DictParser 解析文件, 成功后原子地替换当前版本; 解析失败时保留旧版本.
+// 读者通过 current() 拿到某个版本的 shared_ptr 后可以一直安全地读, 旧版本在最后一个读者释放后才会析构,
+// 相当于以 shared_ptr 的引用计数作为 RCU 的宽限期. 读者不会被解析过程阻塞.
+class DictReloader {
+   public:
+    // parser_factory 每次 reload 时调用一次, 返回一个配置好 (mmap/线程数/列存等) 但尚未解析的 DictParser
+    typedef std::function<std::shared_ptr<DictParser>()> ParserFactory;
+
+    explicit DictReloader(const ParserFactory& parser_factory)
+        : parser_factory_(parser_factory), next_version_(1), reloading_(false) {}
+
+    ~DictReloader() { wait(); }
+
+    // current: 当前发布的版本, 第一次 reload 成功之前为空
+    std::shared_ptr<const DictVersion> current() const { return std::atomic_load(&current_); }
+
+    // reload: 同步解析并发布新版本, 多个 reload 之间互斥
+    bool reload() {
+        std::lock_guard<std::mutex> guard(reload_mutex_);
+        std::shared_ptr<DictParser> parser = parser_factory_();
+        if (!parser || !parser->parse_file()) {
+            LOG(ERROR) << "reload dict failed, keep version " << (current() ? current()->version() : 0);
+            return false;
+        }
+        std::shared_ptr<const DictVersion> version = std::make_shared<DictVersion>(next_version_++, parser);
+        std::atomic_store(&current_, version);
+        return true;
+    }
+
+    // reload_async: 在后台线程中 reload, 已经有后台 reload 在进行时返回 false.
+    // reload_async 和 wait 需要在同一个控制线程中调用
+    bool reload_async() {
+        bool expected = false;
+        if (!reloading_.compare_exchange_strong(expected, true)) {
+            return false;
+        }
+        if (reload_thread_.joinable()) {
+            reload_thread_.join();
+        }
+        reload_thread_ = std::thread([this]() {
+            reload();
+            reloading_.store(false);
+        });
+        return true;
+    }
+
+    // wait: 等待后台 reload 结束
+    void wait() {
+        if (reload_thread_.joinable()) {
+            reload_thread_.join();
+        }
+    }
+
+   private:
+    DictReloader(const DictReloader&);
+    DictReloader& operator=(const DictReloader&);
+
+    ParserFactory parser_factory_;
+    std::shared_ptr<const DictVersion> current_;
+    std::mutex reload_mutex_;
+    uint64_t next_version_;
+    std::atomic<bool> reloading_;
+    std::thread reload_thread_;
+};
+
+}  // namespace dict_parser
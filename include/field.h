@@ -14,95 +14,119 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <exception>
+#include <functional>
 #include <iostream>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <sstream>
 #include <string>
 #include <tuple>
+#include <typeinfo>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "arena.h"
+#include "binary_codec.h"
+#include "delim_scanner.h"
+#include "demangle.h"
 #include "logging.h"
+#include "number_parser.h"
+#include "parse_error.h"
+#include "string_piece.h"
+#include "string_pool.h"
 
 namespace dict_field {
 
 // parse: 用来解析 string 的 函数模板, Field 的 deserilization 中调用
 // 如果想要使用 Field<T> 务必特化 该类型的 parse 方法.
 // input:
-//      inp: 需要解析的 string
+//      inp: 需要解析的 string 切片
 //      data: 解析的结果存储到 data 中
 // output:
 //      bool: 解析是否成功, 如果不成功则返回 false
+// 自定义类型的 parse 方法接收 const std::string &, 所以这里需要拷贝一次.
 template <typename T>
-bool parse(const std::string &inp, T &data) {
-    return data.parse(inp);
+bool parse(const StringPiece &inp, T &data) {
+    if (!data.parse(inp.as_string())) {
+        ParseError::set(kInvalidCustomType);
+        return false;
+    }
+    return true;
 }
 
+// 数值类型的 parse 要求整个 inp 都是合法的数值, 超出目标类型范围 (例如 uint32 溢出) 也视为失败.
+// 解析失败时不打日志, 失败原因记录在 ParseError 中
 template <>
-inline bool parse(const std::string &inp, int &data) {
-    bool is_succ = true;
-    try {
-        data = std::stoi(inp);
-    } catch (const std::exception &e) {
+inline bool parse(const StringPiece &inp, int &data) {
+    if (!parse_integer(inp.begin(), inp.end(), data)) {
         data = 0;
-        is_succ = false;
-        LOG(ERROR) << e.what();
+        ParseError::set(kInvalidInt);
+        return false;
     }
-    return is_succ;
+    return true;
 }
 
 template <>
-inline bool parse(const std::string &inp, uint32_t &data) {
-    bool is_succ = true;
-    try {
-        data = std::stoul(inp);
-    } catch (const std::exception &e) {
+inline bool parse(const StringPiece &inp, uint32_t &data) {
+    if (!parse_integer(inp.begin(), inp.end(), data)) {
         data = 0;
-        is_succ = false;
-        LOG(ERROR) << e.what();
+        ParseError::set(kInvalidUint32);
+        return false;
     }
-    return is_succ;
+    return true;
 }
 
 template <>
-inline bool parse(const std::string &inp, uint64_t &data) {
-    bool is_succ = true;
-    try {
-        data = std::stoull(inp);
-    } catch (const std::exception &e) {
+inline bool parse(const StringPiece &inp, uint64_t &data) {
+    if (!parse_integer(inp.begin(), inp.end(), data)) {
         data = 0;
-        is_succ = false;
-        LOG(WARNING) << e.what();
+        ParseError::set(kInvalidUint64);
+        return false;
     }
-    return is_succ;
+    return true;
 }
 
 template <>
-inline bool parse(const std::string &inp, float &data) {
-    bool is_succ = true;
-    try {
-        data = std::stof(inp);
-    } catch (const std::exception &e) {
+inline bool parse(const StringPiece &inp, float &data) {
+    if (!parse_float(inp.begin(), inp.end(), data)) {
         data = 0;
-        is_succ = false;
-        LOG(WARNING) << e.what();
+        ParseError::set(kInvalidFloat);
+        return false;
     }
-    return is_succ;
+    return true;
 }
 
 template <>
-inline bool parse(const std::string &inp, std::string &data) {
+inline bool parse(const StringPiece &inp, std::string &data) {
     bool is_succ = true;
-    data = inp;
-    if (data == std::string("")) {
+    data.assign(inp.data(), inp.size());
+    if (data.empty()) {
+        ParseError::set(kEmptyString);
         is_succ = false;
     }
     return is_succ;
 }
 
+// 与 parse<std::string> 一致, 空字符串视为解析失败. 非空字符串驻留到当前线程的 StringPool 中
+template <>
+inline bool parse(const StringPiece &inp, InternedString &data) {
+    if (inp.empty()) {
+        data = InternedString();
+        ParseError::set(kEmptyString);
+        return false;
+    }
+    data.id = StringPool::current()->intern(inp);
+    return true;
+}
+
 inline void string_splitter(const std::string &str, const std::string &delim, std::vector<std::string> &oitems) {
     oitems.clear();
     auto first = std::begin(str);
@@ -121,13 +145,34 @@ inline void string_splitter(const std::string &str, const std::string &delim, st
     }
 }
 
+// string_splitter 的零拷贝版本, 切分结果指向 str 的底层内存. 单字符分隔符走向量化的 split_by_char
+inline void string_splitter(const StringPiece &str, const std::string &delim, std::vector<StringPiece> &oitems) {
+    if (delim.size() == 1) {
+        split_by_char(str, delim[0], oitems);
+        return;
+    }
+    oitems.clear();
+    const char *first = str.begin();
+    const char *str_end = str.end();
+    while (first < str_end) {
+        const char *second = std::find_first_of(first, str_end, delim.begin(), delim.end());
+
+        if (first != second) {
+            oitems.emplace_back(first, static_cast<size_t>(second - first));
+        }
+        if (second == str_end) break;
+
+        first = second + delim.size();
+    }
+}
+
 inline std::string Replace(const std::string &str, const std::string &nastychars) {
     std::set<char> chars_blacklist;
-    for (int i = 0; i < nastychars.size(); i++) {
+    for (size_t i = 0; i < nastychars.size(); i++) {
         chars_blacklist.insert(nastychars[i]);
     }
     std::ostringstream oss;
-    for (int i = 0; i < str.size(); i++) {
+    for (size_t i = 0; i < str.size(); i++) {
         if (chars_blacklist.find(str[i]) == chars_blacklist.end()) {
             oss << str[i];
         }
@@ -135,33 +180,99 @@ inline std::string Replace(const std::string &str, const std::string &nastychars
     return oss.str();
 }
 
+// FieldNames: field 名和分隔符的全局驻留表. 相同的字符串只保存一份并且永不释放, field 只保存指向它的指针:
+// clone 时只拷贝指针, 不复制字符串, arena 中的 field 也不会因为名字而持有 arena 之外的内存.
+// 只有按名字构造 field (构建 schema) 时才加锁查表, clone 和解析路径上不访问
+class FieldNames {
+   public:
+    static const std::string *intern(const std::string &name) {
+        static const std::string *empty = new std::string();
+        if (name.empty()) {
+            return empty;
+        }
+        static std::mutex mutex;
+        static std::unordered_set<std::string> *names = new std::unordered_set<std::string>();
+        std::lock_guard<std::mutex> lock(mutex);
+        return &*names->insert(name).first;
+    }
+};
+
+// FieldBase: 所有 field 的基类. 自定义子类除了 deserilization 之外还需要实现 clone_to,
+// RecordTemplate 用它复制出每一行的 Record. 可以直接继承 ClonableField<Derived> 获得基于拷贝构造的 clone_to;
+// 没有实现时 clone_to 会 LOG(FATAL) 并给出类型名
 class FieldBase {
    public:
-    FieldBase(std::string name) : name_(name) {}
-    std::string name() { return name_; }
-    virtual bool deserilization(const std::string &inp) = 0;
+    FieldBase(std::string name) : name_(FieldNames::intern(name)) {}
+    std::string name() { return *name_; }
+    const std::string &name_ref() const { return *name_; }
+    virtual bool deserilization(const StringPiece &inp) = 0;
+    // clone: 以当前 field 为原型复制出一个结构相同的新 field, 用于 RecordTemplate 快速生成 Record
+    std::shared_ptr<FieldBase> clone() const { return clone_to(nullptr); }
+    // clone_to: 同 clone, arena 不为空时新 field 及其子 field 都由 arena 构造并拥有, 见 new_field
+    virtual std::shared_ptr<FieldBase> clone_to(Arena *arena) const {
+        LOG(FATAL) << "field [" << *name_ << "] of type " << demangle(typeid(*this).name())
+                   << " does not implement clone_to, derive it from ClonableField or override clone_to";
+        return nullptr;
+    }
+    // 二进制快照相关, 见 snapshot.h
+    // append_signature: 把 field 的类型和名字追加到 signature 中, 用于计算 schema 指纹
+    virtual void append_signature(std::string &signature) const {
+        signature.append(typeid(*this).name()).append(":").append(*name_);
+    }
+    virtual bool dump(BinaryWriter &writer) const { return false; }
+    virtual bool load(BinaryReader &reader) { return false; }
+    // min_encoded_bytes: dump 至少写入的字节数, ArrayField 加载快照时用来检查元素个数是否可信.
+    // 子类按需隐藏这个静态函数, 自定义 field 的 dump 至少要写入 1 个字节
+    static size_t min_encoded_bytes() { return 1; }
     virtual ~FieldBase(){};
     // 对于 非 ComposedFields 来说, num_fields 都为0
-    virtual int num_fields() { return 0; }
+    virtual int num_fields() const { return 0; }
 
    private:
-    std::string name_;
+    // 见 FieldNames
+    const std::string *name_;
+};
+
+// ClonableField: 为自定义 field 提供基于拷贝构造的 clone_to, 用法:
+//      class MyField : public ClonableField<MyField> { ... };
+// Base 可以是 FieldBase 或者其它已有的 field 类型
+template <typename Derived, typename Base = FieldBase>
+class ClonableField : public Base {
+   public:
+    using Base::Base;
+
+    std::shared_ptr<FieldBase> clone_to(Arena *arena) const override {
+        return new_field<Derived>(arena, static_cast<const Derived &>(*this));
+    }
 };
 
-// Field 当前支持 int, float, uint32, uint64, string. 如果需要支持其它类型, 需要自行特化 parse
+// Field 当前支持 int, float, uint32, uint64, string 以及驻留字符串 InternedString. 如果需要支持其它类型, 需要自行特化 parse
 template <typename T>
 class Field : public FieldBase {
    public:
-    Field(const std::string &name) : FieldBase(name) {}
+    typedef T value_type;
+
+    Field(const std::string &name) : FieldBase(name), data_() {}
     Field(const std::string &name, const T &value) : FieldBase(name), data_(value) {}
 
-    bool deserilization(const std::string &inp) override {
-        bool is_succ;
-        is_succ = parse(inp, data_);
-        return is_succ;
+    bool deserilization(const StringPiece &inp) override {
+        if (!parse(inp, data_)) {
+            ParseError::set_field_type(typeid(*this));
+            return false;
+        }
+        return true;
     }
 
-    T data() { return data_; }
+    std::shared_ptr<FieldBase> clone_to(Arena *arena) const override {
+        return new_field<Field<T>>(arena, *this);
+    }
+
+    bool dump(BinaryWriter &writer) const override { return BinaryCodec<T>::write(writer, data_); }
+    bool load(BinaryReader &reader) override { return BinaryCodec<T>::read(reader, data_); }
+    static size_t min_encoded_bytes() { return codec_min_bytes<T>(); }
+
+    // 返回引用, 读取字符串等类型时不拷贝
+    const T &data() const { return data_; }
 
     static std::shared_ptr<FieldBase> new_instance(const std::string &name) { return std::make_shared<Field<T>>(name); }
 
@@ -169,72 +280,179 @@ class Field : public FieldBase {
     T data_;
 };
 
+// Field<T> 只持有驻留的名字和 T, T 可以平凡析构时 Arena 直接丢弃, 释放解析结果时不逐个访问
+template <typename T>
+struct arena_skip_destructor<Field<T>> : std::is_trivially_destructible<T> {};
+
+// SplitBufferPool: 每个线程按嵌套深度复用切分缓冲区, 避免每次反序列化都重新分配 vector
+class SplitBufferPool {
+   public:
+    class Guard {
+       public:
+        Guard() : pool_(instance()) {
+            if (pool_.depth_ == pool_.buffers_.size()) {
+                pool_.buffers_.emplace_back();
+            }
+            buffer_ = &pool_.buffers_[pool_.depth_++];
+        }
+        ~Guard() { pool_.depth_--; }
+        std::vector<StringPiece> &buffer() { return *buffer_; }
+
+       private:
+        SplitBufferPool &pool_;
+        std::vector<StringPiece> *buffer_;
+    };
+
+   private:
+    SplitBufferPool() : depth_(0) {}
+    static SplitBufferPool &instance() {
+        static thread_local SplitBufferPool pool;
+        return pool;
+    }
+    // 用 deque 保证扩容时已借出的缓冲区地址不变
+    std::deque<std::vector<StringPiece>> buffers_;
+    size_t depth_;
+};
+
 // ComposedFieldBase  组合 field 的基模板, ArrayField, NestedField, Record都继承该模板
+// name -> 下标 的索引在通过 clone 得到的 field 之间共享, 只有在 add_field 时才会复制一份 (copy-on-write).
+// clone 到 arena 中的 field 对原型的索引只持有不计数的引用, 原型在它们存活期间不能被修改或释放
 template <typename T>
 class ComposedFieldBase : public FieldBase {
    public:
-    ComposedFieldBase(const std::string &name, const std::string &delim) : FieldBase(name), delim_(delim) {}
+    ComposedFieldBase(const std::string &name, const std::string &delim)
+        : FieldBase(name), named_fields_(std::make_shared<NameIndex>()), delim_(FieldNames::intern(delim)) {}
 
     bool add_field(std::shared_ptr<T> field) {
-        if (named_fields_.find(field->name()) != named_fields_.end()) {
-            LOG(ERROR) << "duplicated field name " << field->name();
+        if (named_fields_->find(field->name_ref()) != named_fields_->end()) {
+            LOG(ERROR) << "duplicated field name " << field->name_ref();
 
             return false;
         }
+        // arena 中的 clone 不计数 (use_count 为 0), 同样需要先复制
+        if (named_fields_.use_count() != 1) {
+            named_fields_ = std::make_shared<NameIndex>(*named_fields_);
+        }
+        named_fields_->insert(std::make_pair(field->name_ref(), sub_fields_.size()));
         sub_fields_.push_back(field);
-        named_fields_.insert(std::make_pair(field->name(), field));
         return true;
     }
 
-    bool deserilization(const std::string &inp) override {
+    bool deserilization(const StringPiece &inp) override {
         // deserilization 设计为两个阶段: 一个是将数据 分成 list of string items, 然后再处理一下
         // 其中 deserilization_stage1 负责 讲 string spit 为 list of string items
         // set_data 负责 将 list of string items 解析成相应的 field
         // input:
         //      inp: 需要序列化的 string
         // output:
-        //      bool : 解析过程中是否 出现错误, 如果发生错误, 返回 false
-        std::vector<std::string> items;
+        //      bool : 解析过程中是否 出现错误, 如果发生错误, 返回 false, 错误原因记录在 ParseError 中
+        SplitBufferPool::Guard guard;
+        std::vector<StringPiece> &items = guard.buffer();
         bool is_succ = deserilization_stage1(inp, items);
 
         if (!is_succ) {
-            LOG(ERROR) << "parse error:" << inp;
+            ParseError::set_field_type(typeid(*this));
             return is_succ;
         }
 
-        is_succ = set_data(items);
-        if (!is_succ) {
-            LOG(ERROR) << "parse error:" << inp;
-        }
-        return is_succ;
+        return set_data(items);
     }
 
     std::shared_ptr<T> get_field(const std::string &name) {
         std::shared_ptr<T> retval;
-        if (named_fields_.find(name) != named_fields_.end()) retval = named_fields_.find(name)->second;
+        auto iter = named_fields_->find(name);
+        if (iter != named_fields_->end()) retval = sub_fields_[iter->second];
         return retval;
     }
 
     std::shared_ptr<T> sub_fields_at(int i) {
-        if (i >= sub_fields_.size()) {
+        if (i < 0 || static_cast<size_t>(i) >= sub_fields_.size()) {
             LOG(ERROR) << "i >= sub_fields_.size()";
             return nullptr;
         }
         return sub_fields_[i];
     }
 
-    int num_fields() override { return sub_fields_.size(); }
+    // 以下两个接口返回裸指针, 不拷贝 shared_ptr, 读路径上没有引用计数的原子操作.
+    // 返回的指针在本 field 存活期间有效
+    T *get_field_ptr(const std::string &name) const {
+        auto iter = named_fields_->find(name);
+        return iter != named_fields_->end() ? sub_fields_[iter->second].get() : nullptr;
+    }
+
+    T *sub_field_ptr_at(size_t i) const { return i < sub_fields_.size() ? sub_fields_[i].get() : nullptr; }
+
+    int num_fields() const override { return sub_fields_.size(); }
+
+    void append_signature(std::string &signature) const override {
+        FieldBase::append_signature(signature);
+        signature.append("(").append(*delim_).append(")[");
+        for (const auto &field : sub_fields_) {
+            field->append_signature(signature);
+            signature.append(";");
+        }
+        signature.append("]");
+    }
+
+    static size_t min_encoded_bytes() { return sizeof(uint32_t); }
+
+    bool dump(BinaryWriter &writer) const override {
+        writer.write_pod(static_cast<uint32_t>(sub_fields_.size()));
+        for (const auto &field : sub_fields_) {
+            if (!field->dump(writer)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool load(BinaryReader &reader) override {
+        uint32_t num_sub_fields = 0;
+        if (!reader.read_pod(num_sub_fields) || !prepare_load(num_sub_fields, reader)) {
+            return false;
+        }
+        for (const auto &field : sub_fields_) {
+            if (!field->load(reader)) {
+                return false;
+            }
+        }
+        return true;
+    }
 
    protected:
-    bool set_data(const std::vector<std::string> &items) {
+    // 克隆构造: 与 prototype 共享名字, 分隔符和 name 索引, 子 field 逐个 clone_to 到 arena 中
+    ComposedFieldBase(const ComposedFieldBase &prototype, Arena *arena)
+        : FieldBase(prototype),
+          sub_fields_(ArenaAllocator<std::shared_ptr<T>>(arena)),
+          named_fields_(arena != nullptr
+                            ? std::shared_ptr<NameIndex>(std::shared_ptr<NameIndex>(), prototype.named_fields_.get())
+                            : prototype.named_fields_),
+          delim_(prototype.delim_) {
+        sub_fields_.reserve(prototype.sub_fields_.size());
+        for (const auto &field : prototype.sub_fields_) {
+            sub_fields_.push_back(std::static_pointer_cast<T>(field->clone_to(arena)));
+        }
+    }
+
+    // append_sub_field: 追加一个不进入 name 索引的子 field, 用于只按下标访问的数组元素
+    void append_sub_field(std::shared_ptr<T> field) { sub_fields_.push_back(std::move(field)); }
+
+    // prepare_load: 快照中的子 field 个数与当前结构不一致时返回 false, ArrayField 会按需扩充子 field.
+    // reader 用来在扩充之前检查个数是否超出快照剩余的字节数
+    virtual bool prepare_load(size_t num_sub_fields, const BinaryReader &) {
+        return num_sub_fields == sub_fields_.size();
+    }
+
+    typedef std::unordered_map<std::string, size_t> NameIndex;
+
+    bool set_data(const std::vector<StringPiece> &items) {
         if (items.size() != sub_fields_.size()) {
-            std::ostringstream oss;
-            oss << "items.size=" << items.size() << ", sub_fields_.size=" << sub_fields_.size() << " mismatch\n";
-            LOG(ERROR) << oss.str();
+            ParseError::set(kFieldCountMismatch);
+            ParseError::set_field_type(typeid(*this));
             return false;
         }
-        for (int i = 0; i < items.size() && i < sub_fields_.size(); i++) {
-            std::shared_ptr<T> field = sub_fields_[i];
+        for (size_t i = 0; i < items.size() && i < sub_fields_.size(); i++) {
+            const std::shared_ptr<T> &field = sub_fields_[i];
             if (!field->deserilization(items[i])) {
                 return false;
             }
@@ -242,20 +460,50 @@ class ComposedFieldBase : public FieldBase {
         return true;
     }
 
-    virtual bool deserilization_stage1(const std::string &inp, std::vector<std::string> &out) {
-        string_splitter(inp, delim_, out);
+    virtual bool deserilization_stage1(const StringPiece &inp, std::vector<StringPiece> &out) {
+        string_splitter(inp, *delim_, out);
         return true;
     };
 
-    const std::vector<std::shared_ptr<T>> &sub_fields() { return sub_fields_; }
-    const std::string &delim() { return delim_; }
+   public:
+    typedef std::vector<std::shared_ptr<T>, ArenaAllocator<std::shared_ptr<T>>> SubFieldVector;
+
+    const SubFieldVector &sub_fields() const { return sub_fields_; }
+    const std::string &delim() const { return *delim_; }
+    // arena: clone_to 时传入的 arena, 本 field 不在 arena 中时为空
+    Arena *arena() const { return sub_fields_.get_allocator().arena(); }
 
    private:
-    std::vector<std::shared_ptr<T>> sub_fields_;
-    std::unordered_map<std::string, std::shared_ptr<T>> named_fields_;
-    std::string delim_;
+    SubFieldVector sub_fields_;
+    std::shared_ptr<NameIndex> named_fields_;
+    // 见 FieldNames
+    const std::string *delim_;
 };
 
+// array_splitter: 将 "N:a,b,c" 格式的数组切分成 N 个元素, 格式错误或者元素个数与 N 不一致时返回 false
+inline bool array_splitter(const StringPiece &inp, const std::string &delim, std::vector<StringPiece> &out) {
+    SplitBufferPool::Guard guard;
+    std::vector<StringPiece> &items = guard.buffer();
+    string_splitter(inp, ":", items);
+    if (items.size() != 2) {
+        ParseError::set(kArrayFormatError);
+        return false;
+    }
+
+    size_t numele = 0;
+    if (!parse_integer(items[0].begin(), items[0].end(), numele)) {
+        ParseError::set(kInvalidArraySize);
+        return false;
+    }
+    string_splitter(items[1], delim, out);
+
+    if (numele != out.size()) {
+        ParseError::set(kArraySizeMismatch);
+        return false;
+    }
+    return true;
+}
+
 template <typename T>
 class ArrayField : public ComposedFieldBase<T> {
    public:
@@ -264,37 +512,154 @@ class ArrayField : public ComposedFieldBase<T> {
         return std::make_shared<ArrayField<T>>(name);
     }
 
+    ArrayField(const ArrayField &prototype, Arena *arena) : ComposedFieldBase<T>(prototype, arena) {}
+
+    std::shared_ptr<FieldBase> clone_to(Arena *arena) const override {
+        return new_field<ArrayField<T>>(arena, *this, arena);
+    }
+
+    // get_field/get_field_ptr: 解析时扩充的元素没有名字, 除 add_field 加入的具名元素外,
+    // 仍然可以用 "sub_field_<i>" 按下标取第 i 个元素
+    std::shared_ptr<T> get_field(const std::string &name) {
+        std::shared_ptr<T> field = ComposedFieldBase<T>::get_field(name);
+        size_t i = 0;
+        if (!field && element_index(name, i) && i < this->sub_fields().size()) {
+            field = this->sub_fields()[i];
+        }
+        return field;
+    }
+
+    T *get_field_ptr(const std::string &name) const {
+        T *field = ComposedFieldBase<T>::get_field_ptr(name);
+        size_t i = 0;
+        if (field == nullptr && element_index(name, i)) {
+            field = this->sub_field_ptr_at(i);
+        }
+        return field;
+    }
+
    protected:
-    bool deserilization_stage1(const std::string &inp, std::vector<std::string> &out) override {
-        bool is_succ = true;
-        std::vector<std::string> items;
-        string_splitter(inp, ":", items);
-        if (items.size() != 2) {
-            LOG(ERROR) << "fmt error";
+    bool deserilization_stage1(const StringPiece &inp, std::vector<StringPiece> &out) override {
+        if (!array_splitter(inp, this->delim(), out)) {
+            return false;
+        }
+        add_sub_fields(out.size());
+        return true;
+    };
+
+    bool prepare_load(size_t num_sub_fields, const BinaryReader &reader) override {
+        if (!reader.can_hold(num_sub_fields, T::min_encoded_bytes())) {
+            return false;
+        }
+        add_sub_fields(num_sub_fields);
+        return num_sub_fields == ComposedFieldBase<T>::sub_fields().size();
+    }
+
+   private:
+    // add_sub_fields: 把子 field 扩充到 num_sub_fields 个, 新元素与本 field 分配在同一个 arena 中.
+    // 元素只按下标访问, 没有名字, 也不进入 name 索引, 扩充时不拼接名字也不复制共享的索引
+    void add_sub_fields(size_t num_sub_fields) {
+        size_t i = ComposedFieldBase<T>::sub_fields().size();
+        if (i >= num_sub_fields) {
+            return;
+        }
+        Arena *arena = this->arena();
+        const std::string no_name;
+        for (; i < num_sub_fields; i++) {
+            this->append_sub_field(new_field<T>(arena, no_name));
+        }
+    }
+
+    // element_index: 解析 "sub_field_<i>" 形式的元素名
+    static bool element_index(const std::string &name, size_t &i) {
+        static const char kPrefix[] = "sub_field_";
+        const size_t kPrefixLen = sizeof(kPrefix) - 1;
+        return name.size() > kPrefixLen && name.compare(0, kPrefixLen, kPrefix) == 0 &&
+               name[kPrefixLen] >= '0' && name[kPrefixLen] <= '9' &&
+               parse_integer(name.data() + kPrefixLen, name.data() + name.size(), i);
+    }
+};
+
+// FlatArrayField: "N:a,b,c" 格式数组的扁平版本, 元素直接解析到一个类型化的 vector<T> 中.
+// 与 ArrayField 不同, 解析时不会为新元素 add_field, 没有逐元素的名字和 name 索引, 也不修改共享的 schema,
+// 所以同一个原型可以被多个线程同时 clone 并解析. T 支持 int, float, uint32, uint64, string, InternedString
+template <typename T>
+class FlatArrayField : public FieldBase {
+   public:
+    typedef std::vector<T, ArenaAllocator<T>> value_type;
+
+    FlatArrayField(const std::string &name, const std::string &delim = ",")
+        : FieldBase(name), delim_(FieldNames::intern(delim)) {}
+    // 克隆构造: 与 prototype 共享名字和分隔符, 元素数组分配在 arena 中
+    FlatArrayField(const FlatArrayField &prototype, Arena *arena)
+        : FieldBase(prototype), delim_(prototype.delim_), values_(ArenaAllocator<T>(arena)) {}
+
+    static std::shared_ptr<FieldBase> new_instance(const std::string &name) {
+        return std::make_shared<FlatArrayField<T>>(name);
+    }
+
+    bool deserilization(const StringPiece &inp) override {
+        SplitBufferPool::Guard guard;
+        std::vector<StringPiece> &items = guard.buffer();
+        if (!array_splitter(inp, *delim_, items)) {
+            ParseError::set_field_type(typeid(*this));
             return false;
         }
+        // array_splitter 已经校验过元素个数等于 N, 这里一次分配到位
+        values_.resize(items.size());
+        for (size_t i = 0; i < items.size(); i++) {
+            if (!parse(items[i], values_[i])) {
+                ParseError::set_field_type(typeid(*this));
+                return false;
+            }
+        }
+        return true;
+    }
 
-        int numele = 0;
-        try {
-            numele = std::stoi(items[0]);
+    std::shared_ptr<FieldBase> clone_to(Arena *arena) const override {
+        return new_field<FlatArrayField<T>>(arena, *this, arena);
+    }
+
+    void append_signature(std::string &signature) const override {
+        FieldBase::append_signature(signature);
+        signature.append("(").append(*delim_).append(")");
+    }
 
-            string_splitter(items[1], this->delim(), out);
+    static size_t min_encoded_bytes() { return sizeof(uint32_t); }
 
-            if (numele != out.size()) {
-                std::ostringstream oss;
-                oss << "arrayfield numele out.size() mismatch, numele=" << numele << ", out.size=" << out.size();
-                LOG(ERROR) << oss.str();
+    bool dump(BinaryWriter &writer) const override {
+        writer.write_pod(static_cast<uint32_t>(values_.size()));
+        for (const auto &value : values_) {
+            if (!BinaryCodec<T>::write(writer, value)) {
                 return false;
             }
-            int sub_fields_size = ComposedFieldBase<T>::sub_fields().size();
-            for (int i = sub_fields_size; i < out.size(); i++) {
-                this->add_field(std::make_shared<T>("sub_field_" + std::to_string(i)));
+        }
+        return true;
+    }
+
+    bool load(BinaryReader &reader) override {
+        uint32_t size = 0;
+        if (!reader.read_pod(size) || !reader.can_hold(size, codec_min_bytes<T>())) {
+            return false;
+        }
+        values_.resize(size);
+        for (auto &value : values_) {
+            if (!BinaryCodec<T>::read(reader, value)) {
+                return false;
             }
-        } catch (const std::exception &err) {
-            is_succ = false;
         }
-        return is_succ;
-    };
+        return true;
+    }
+
+    size_t size() const { return values_.size(); }
+    const T &at(size_t i) const { return values_[i]; }
+    const value_type &data() const { return values_; }
+    const std::string &delim() const { return *delim_; }
+
+   private:
+    // 见 FieldNames
+    const std::string *delim_;
+    value_type values_;
 };
 
 class NestedField : public ComposedFieldBase<FieldBase> {
@@ -303,43 +668,172 @@ class NestedField : public ComposedFieldBase<FieldBase> {
     static std::shared_ptr<FieldBase> new_instance(const std::string &name) {
         return std::make_shared<NestedField>(name);
     }
+
+    NestedField(const NestedField &prototype, Arena *arena) : ComposedFieldBase<FieldBase>(prototype, arena) {}
+
+    std::shared_ptr<FieldBase> clone_to(Arena *arena) const override {
+        return new_field<NestedField>(arena, *this, arena);
+    }
 };
 
 class Record : public ComposedFieldBase<FieldBase> {
    public:
     Record(const std::string &name = "record", const std::string &delim = "\t")
         : ComposedFieldBase<FieldBase>(name, delim) {}
+
+    // deserilization: 同 ComposedFieldBase::deserilization, 额外返回顶层切分的耗时 (纳秒), 供 DictParser 统计使用
+    bool deserilization(const StringPiece &inp, uint64_t &split_ns) {
+        SplitBufferPool::Guard guard;
+        std::vector<StringPiece> &items = guard.buffer();
+        auto start = std::chrono::steady_clock::now();
+        bool is_succ = deserilization_stage1(inp, items);
+        split_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        if (!is_succ) {
+            ParseError::set_field_type(typeid(*this));
+            return is_succ;
+        }
+        return set_data(items);
+    }
+    using ComposedFieldBase<FieldBase>::deserilization;
+
+    Record(const Record &prototype, Arena *arena) : ComposedFieldBase<FieldBase>(prototype, arena) {}
+
+    std::shared_ptr<FieldBase> clone_to(Arena *arena) const override {
+        return new_field<Record>(arena, *this, arena);
+    }
+};
+
+// RecordTemplate: 编译好的 schema. 由 record_builder 或 header_file 构建一次原型 Record,
+// 之后每一行都通过 clone 原型生成新的 Record, 不再重复构建 name 索引
+class RecordTemplate {
+   public:
+    explicit RecordTemplate(std::shared_ptr<Record> prototype) : prototype_(prototype) {}
+
+    // arena 不为空时, 新 Record 的所有节点都由 arena 构造并拥有, 只在 arena 和本 RecordTemplate 存活期间有效
+    std::shared_ptr<Record> new_record(Arena *arena = nullptr) const {
+        return std::static_pointer_cast<Record>(prototype_->clone_to(arena));
+    }
+
+    std::shared_ptr<const Record> prototype() const { return prototype_; }
+
+   private:
+    std::shared_ptr<Record> prototype_;
+};
+
+
+typedef std::function<std::shared_ptr<FieldBase>(const std::string &)> FieldBuilder;
+
+// FieldRegistry: 注册名 -> FieldBuilder 的不可变表. 构造时选取一个 seed, 使所有注册名的哈希值落在不同的槽位上
+// (完美哈希), 查找时只计算一次哈希并比较一次名字, 没有探测和锁
+class FieldRegistry {
+   public:
+    struct Entry {
+        std::string name;
+        FieldBuilder builder;
+    };
+
+    explicit FieldRegistry(const std::vector<Entry> &entries) : entries_(entries), seed_(0) {
+        size_t num_slots = 1;
+        while (num_slots < entries_.size() * 2) {
+            num_slots <<= 1;
+        }
+        // 槽位数至少是条目数的两倍, 通常几次尝试就能找到无冲突的 seed, 找不到时加倍槽位数
+        while (!try_seed(num_slots)) {
+            if (++seed_ % kMaxSeedTrials == 0) {
+                num_slots <<= 1;
+            }
+        }
+    }
+
+    // find: name 没有注册时返回 nullptr
+    const Entry *find(const std::string &name) const {
+        if (entries_.empty()) {
+            return nullptr;
+        }
+        uint32_t i = slots_[hash(name, seed_) & (slots_.size() - 1)];
+        return i != kEmptySlot && entries_[i].name == name ? &entries_[i] : nullptr;
+    }
+
+    const std::vector<Entry> &entries() const { return entries_; }
+
+   private:
+    static const uint32_t kEmptySlot = 0xffffffffu;
+    static const uint64_t kMaxSeedTrials = 64;
+
+    static uint64_t hash(const std::string &name, uint64_t seed) {
+        uint64_t hash = 14695981039346656037ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+        for (size_t i = 0; i < name.size(); i++) {
+            hash ^= static_cast<unsigned char>(name[i]);
+            hash *= 1099511628211ULL;
+        }
+        return hash ^ (hash >> 29);
+    }
+
+    bool try_seed(size_t num_slots) {
+        slots_.assign(num_slots, static_cast<uint32_t>(kEmptySlot));
+        for (size_t i = 0; i < entries_.size(); i++) {
+            uint32_t &slot = slots_[hash(entries_[i].name, seed_) & (num_slots - 1)];
+            if (slot != kEmptySlot) {
+                return false;
+            }
+            slot = static_cast<uint32_t>(i);
+        }
+        return true;
+    }
+
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> slots_;
+    uint64_t seed_;
 };
 
+// FieldManager: 注册名到 field 构造函数的全局注册表.
+// 读路径 (get_field_by_name / record_builder) 只原子地读一次当前的 FieldRegistry 指针, 然后在不可变表上查找,
+// 与其他解析线程以及并发的注册之间都没有锁, 是 wait-free 的.
+// register_field 在写锁内复制当前表, 加入新条目后重建完美哈希, 再原子地发布新表 (copy-on-write).
+// 旧表在 FieldManager 的生命周期内一直保留, 正在读旧表的线程不会访问已释放的内存.
+// 注册只发生在启动阶段 (REGISTER_FIELD) 或者很少发生, 保留旧表的开销可以忽略
 class FieldManager {
    public:
     static FieldManager *instance() {
         static FieldManager field_manager;
         return &field_manager;
     }
-    void register_field(const std::string &name,
-                        std::function<std::shared_ptr<FieldBase>(const std::string &)> field_builder) {
-        if (registered_fields_.find(name) == registered_fields_.end()) {
-            registered_fields_.insert(std::make_pair(name, field_builder));
+
+    // register_field: 同名的注册只有第一次生效
+    void register_field(const std::string &name, FieldBuilder field_builder) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        const FieldRegistry *current = registry_.load(std::memory_order_relaxed);
+        if (current->find(name) != nullptr) {
+            return;
         }
+        std::vector<FieldRegistry::Entry> entries = current->entries();
+        entries.push_back(FieldRegistry::Entry{name, field_builder});
+        registries_.emplace_back(new FieldRegistry(entries));
+        registry_.store(registries_.back().get(), std::memory_order_release);
+    }
+
+    bool is_registered(const std::string &registered_name) const {
+        return registry()->find(registered_name) != nullptr;
     }
 
     std::shared_ptr<FieldBase> get_field_by_name(const std::string &registered_name, const std::string &field_name) {
         std::shared_ptr<FieldBase> target_field;
-        if (registered_fields_.find(registered_name) != registered_fields_.end()) {
-            auto field_builder = registered_fields_.find(registered_name)->second;
-            target_field = field_builder(field_name);
+        const FieldRegistry::Entry *entry = registry()->find(registered_name);
+        if (entry != nullptr) {
+            target_field = entry->builder(field_name);
         }
         return target_field;
     }
 
     std::shared_ptr<Record> record_builder(const std::vector<std::string> &field_names) {
         std::shared_ptr<Record> record = std::make_shared<Record>("record");
+        // 整个 Record 使用同一个快照, 构建过程中的并发注册不影响本次结果
+        const FieldRegistry *current = registry();
         int unique_name = 0;
         for (const auto &name : field_names) {
-            if (registered_fields_.find(name) != registered_fields_.end()) {
-                std::shared_ptr<FieldBase> field = get_field_by_name(name, std::to_string(unique_name));
-                record->add_field(field);
+            const FieldRegistry::Entry *entry = current->find(name);
+            if (entry != nullptr) {
+                record->add_field(entry->builder(std::to_string(unique_name)));
             } else {
                 LOG(ERROR) << "key [" << name << "] not exist";
             }
@@ -348,15 +842,23 @@ class FieldManager {
         return record;
     }
 
+    // registry: 当前发布的注册表, 在 FieldManager 的生命周期内一直有效
+    const FieldRegistry *registry() const { return registry_.load(std::memory_order_acquire); }
+
    private:
-    FieldManager() {}
-    std::unordered_map<std::string, std::function<std::shared_ptr<FieldBase>(const std::string &)>> registered_fields_;
+    FieldManager() {
+        registries_.emplace_back(new FieldRegistry(std::vector<FieldRegistry::Entry>()));
+        registry_.store(registries_.back().get(), std::memory_order_release);
+    }
+
+    std::mutex write_mutex_;
+    std::vector<std::unique_ptr<const FieldRegistry>> registries_;
+    std::atomic<const FieldRegistry *> registry_;
 };
 
 class FieldRegister {
    public:
-    FieldRegister(const std::string &name,
-                  std::function<std::shared_ptr<FieldBase>(const std::string &)> field_builder) {
+    FieldRegister(const std::string &name, FieldBuilder field_builder) {
         FieldManager::instance()->register_field(name, field_builder);
     }
 };
@@ -376,4 +878,15 @@ REGISTER_FIELD("ArrayField<uint32>", ArrayField<Field<uint32_t>>::new_instance,
 REGISTER_FIELD("ArrayField<uint64>", ArrayField<Field<uint64_t>>::new_instance, 8);
 REGISTER_FIELD("ArrayField<string>", ArrayField<Field<std::string>>::new_instance, 9);
 
+REGISTER_FIELD("FlatArrayField<int>", FlatArrayField<int>::new_instance, 10);
+REGISTER_FIELD("FlatArrayField<float>", FlatArrayField<float>::new_instance, 11);
+REGISTER_FIELD("FlatArrayField<uint32>", FlatArrayField<uint32_t>::new_instance, 12);
+REGISTER_FIELD("FlatArrayField<uint64>", FlatArrayField<uint64_t>::new_instance, 13);
+REGISTER_FIELD("FlatArrayField<string>", FlatArrayField<std::string>::new_instance, 14);
+
+// 驻留字符串, 见 string_pool.h
+REGISTER_FIELD("Field<istring>", Field<InternedString>::new_instance, 15);
+REGISTER_FIELD("ArrayField<istring>", ArrayField<Field<InternedString>>::new_instance, 16);
+REGISTER_FIELD("FlatArrayField<istring>", FlatArrayField<InternedString>::new_instance, 17);
+
 }  // namespace dict_field
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "demangle.h"
+#include "field.h"
+#include "logging.h"
+
+namespace dict_field {
+
+// resolve_field_path: 在原型 Record 上按名字查找 field, 嵌套的子 field 用 "." 连接, 例如 "money.income".
+// 找到时把从 Record 根节点到该 field 的每一层子 field 下标写入 path 并返回该 field, 否则返回 nullptr
+inline const FieldBase *resolve_field_path(const Record &prototype, const std::string &field_name,
+                                           std::vector<size_t> &path) {
+    path.clear();
+    std::vector<std::string> names;
+    string_splitter(field_name, ".", names);
+    const FieldBase *field = &prototype;
+    for (const auto &name : names) {
+        const ComposedFieldBase<FieldBase> *composed = dynamic_cast<const ComposedFieldBase<FieldBase> *>(field);
+        if (composed == nullptr) {
+            return nullptr;
+        }
+        size_t i = 0;
+        while (i < composed->sub_fields().size() && composed->sub_fields()[i]->name_ref() != name) {
+            i++;
+        }
+        if (i == composed->sub_fields().size()) {
+            return nullptr;
+        }
+        path.push_back(i);
+        field = composed->sub_fields()[i].get();
+    }
+    return path.empty() ? nullptr : field;
+}
+
+// follow_field_path: 按 resolve_field_path 得到的下标取出 record 中对应的 field, 不做名字查找和类型检查.
+// record 必须和解析 path 时使用的原型具有相同的 schema (例如由同一个 RecordTemplate 生成)
+inline const FieldBase *follow_field_path(const Record &record, const std::vector<size_t> &path) {
+    const FieldBase *field = &record;
+    for (size_t i : path) {
+        field = static_cast<const ComposedFieldBase<FieldBase> *>(field)->sub_fields()[i].get();
+    }
+    return field;
+}
+
+// FieldHandle: 编译期确定类型的 field 访问句柄. 在原型上解析一次名字和类型, 之后每次访问只是按下标取子 field
+// 再 static_cast, 没有哈希查找, dynamic_cast 和 shared_ptr 拷贝. 例如:
+//      FieldHandle<Field<std::string>> name_handle;
+//      name_handle.resolve(*dictparser.record_template()->prototype(), "name");
+//      for (const auto &record : dictparser.parsed_result()) {
+//          const std::string &name = name_handle.value(*record);
+//      }
+template <typename FieldT>
+class FieldHandle {
+   public:
+    FieldHandle() {}
+
+    // resolve: field 不存在或类型不是 FieldT 时返回 false
+    bool resolve(const Record &prototype, const std::string &field_name) {
+        const FieldBase *field = resolve_field_path(prototype, field_name, path_);
+        if (field == nullptr) {
+            LOG(ERROR) << "field [" << field_name << "] not exist";
+            path_.clear();
+            return false;
+        }
+        if (dynamic_cast<const FieldT *>(field) == nullptr) {
+            LOG(ERROR) << "field [" << field_name << "] is not a " << demangle(typeid(FieldT).name());
+            path_.clear();
+            return false;
+        }
+        return true;
+    }
+
+    bool valid() const { return !path_.empty(); }
+
+    // get: record 必须和 resolve 时的原型具有相同的 schema
+    const FieldT &get(const Record &record) const {
+        return *static_cast<const FieldT *>(follow_field_path(record, path_));
+    }
+
+    // value: 只适用于 Field<T>, 返回 data 的引用
+    template <typename F = FieldT>
+    const typename F::value_type &value(const Record &record) const {
+        return get(record).data();
+    }
+
+   private:
+    std::vector<size_t> path_;
+};
+
+}  // namespace dict_field
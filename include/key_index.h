@@ -0,0 +1,286 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "field.h"
+#include "field_handle.h"
+#include "logging.h"
+
+namespace dict_field {
+
+// RowRange: 某个 key 对应的所有行号, 按加入索引的顺序 (即文件中的行序) 遍历.
+// 只是索引内部链表的一个视图, 不分配内存; 索引被修改后失效
+class RowRange {
+   public:
+    class iterator {
+       public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef size_t value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const size_t *pointer;
+        typedef size_t reference;
+
+        iterator(const std::vector<size_t> *next, size_t row) : next_(next), row_(row) {}
+        size_t operator*() const { return row_; }
+        iterator &operator++() {
+            row_ = (*next_)[row_];
+            return *this;
+        }
+        bool operator==(const iterator &other) const { return row_ == other.row_; }
+        bool operator!=(const iterator &other) const { return row_ != other.row_; }
+
+       private:
+        const std::vector<size_t> *next_;
+        size_t row_;
+    };
+
+    static const size_t kNoRow = static_cast<size_t>(-1);
+
+    RowRange() : next_(nullptr), first_(kNoRow), size_(0) {}
+    RowRange(const std::vector<size_t> *next, size_t first, size_t size) : next_(next), first_(first), size_(size) {}
+
+    iterator begin() const { return iterator(next_, first_); }
+    iterator end() const { return iterator(next_, kNoRow); }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    // front: 第一行 (行号最小), 调用前需保证不为空
+    size_t front() const { return first_; }
+
+   private:
+    const std::vector<size_t> *next_;
+    size_t first_;
+    size_t size_;
+};
+
+// KeyIndex: 按某个 field 的值建立的哈希索引, 值为该 Record 在解析结果中的下标.
+// field_name 可以是顶层 field, 也可以用 "." 指定 NestedField 中的子 field, 例如 "money.income".
+// key field 的类型支持 Field<std::string> 和 Field<int/uint32/uint64>, 索引直接以 field 的原生类型为 key:
+// 数值 key 不格式化成字符串, 字符串 key 是指向 Record 中数据的 StringPiece, 建索引时不拷贝,
+// 所以被索引的 Record 在索引存活期间必须保持存活且不再修改.
+// 同一个 key 可以对应多行 (multimap 语义), 同一个 key 的行号串成链表, 查找返回 RowRange, 不分配内存.
+class KeyIndex {
+   public:
+    enum KeyType { kStringKey, kIntKey, kUint32Key, kUint64Key };
+
+    virtual ~KeyIndex() {}
+
+    // create: 在原型 Record 上解析出 key field 的位置和类型, 之后 add 时不再做名字查找和 dynamic_cast.
+    // field 不存在或类型不支持时返回 nullptr
+    static std::shared_ptr<KeyIndex> create(const Record &prototype, const std::string &field_name);
+
+    const std::string &field_name() const { return field_name_; }
+    KeyType key_type() const { return key_type_; }
+
+    // add: row 必须大于之前加入的所有行号
+    virtual void add(const Record &record, size_t row) = 0;
+    virtual void reserve(size_t num_rows) = 0;
+    virtual void clear() = 0;
+    // size: 加入索引的行数
+    virtual size_t size() const = 0;
+
+    // equal_range: 字符串 key. 数值类型的索引按十进制解析 key, 不合法或超出范围时返回空
+    RowRange equal_range(const StringPiece &key) const;
+
+    // equal_range: 数值 key. 字符串类型的索引, 或者 key 超出索引类型的范围时返回空
+    template <typename Int>
+    typename std::enable_if<std::is_integral<Int>::value, RowRange>::type equal_range(Int key) const;
+
+   protected:
+    KeyIndex(const std::string &field_name, const std::vector<size_t> &path, KeyType key_type)
+        : field_name_(field_name), path_(path), key_type_(key_type) {}
+
+    const FieldBase *key_field(const Record &record) const { return follow_field_path(record, path_); }
+
+   private:
+    template <typename K>
+    RowRange find(const K &key) const;
+
+    std::string field_name_;
+    // 见 resolve_field_path
+    std::vector<size_t> path_;
+    KeyType key_type_;
+};
+
+// TypedKeyIndex: key 类型为 K 的 KeyIndex, K 为 StringPiece/int/uint32_t/uint64_t
+template <typename K>
+class TypedKeyIndex : public KeyIndex {
+   public:
+    typedef typename std::conditional<std::is_same<K, StringPiece>::value, std::string, K>::type FieldValue;
+    typedef typename std::conditional<std::is_same<K, StringPiece>::value, StringPieceHash, std::hash<K>>::type Hash;
+
+    TypedKeyIndex(const std::string &field_name, const std::vector<size_t> &path, KeyType key_type)
+        : KeyIndex(field_name, path, key_type), num_rows_(0) {}
+
+    void add(const Record &record, size_t row) override {
+        K key(static_cast<const Field<FieldValue> *>(key_field(record))->data());
+        if (row >= next_.size()) {
+            next_.resize(row + 1, static_cast<size_t>(RowRange::kNoRow));
+        }
+        // 先 find 再插入: 已有的 key 不会像 insert 那样先分配一个节点再丢弃
+        auto iter = chains_.find(key);
+        if (iter == chains_.end()) {
+            chains_.emplace(key, Chain{row, row, 1});
+        } else {
+            Chain &chain = iter->second;
+            next_[chain.last] = row;
+            chain.last = row;
+            chain.size++;
+        }
+        num_rows_++;
+    }
+
+    void reserve(size_t num_rows) override {
+        chains_.reserve(num_rows);
+        next_.reserve(num_rows);
+    }
+
+    void clear() override {
+        chains_.clear();
+        next_.clear();
+        num_rows_ = 0;
+    }
+
+    size_t size() const override { return num_rows_; }
+
+    RowRange find(const K &key) const {
+        auto iter = chains_.find(key);
+        if (iter == chains_.end()) {
+            return RowRange();
+        }
+        return RowRange(&next_, iter->second.first, iter->second.size);
+    }
+
+   private:
+    struct Chain {
+        size_t first;
+        size_t last;
+        size_t size;
+    };
+
+    std::unordered_map<K, Chain, Hash> chains_;
+    // next_[row]: 与 row 的 key 相同的下一行, 没有时为 RowRange::kNoRow
+    std::vector<size_t> next_;
+    size_t num_rows_;
+};
+
+namespace key_index_internal {
+
+template <typename T>
+bool is_negative(T value, std::true_type) {
+    return value < 0;
+}
+
+template <typename T>
+bool is_negative(T, std::false_type) {
+    return false;
+}
+
+// cast_key: 把任意整数转换成索引的 key 类型 To, 超出 To 的范围时返回 false
+template <typename To, typename From>
+bool cast_key(From value, To &out) {
+    if (is_negative(value, std::is_signed<From>())) {
+        if (!std::is_signed<To>::value ||
+            static_cast<int64_t>(value) < static_cast<int64_t>(std::numeric_limits<To>::min())) {
+            return false;
+        }
+    } else if (static_cast<uint64_t>(value) > static_cast<uint64_t>(std::numeric_limits<To>::max())) {
+        return false;
+    }
+    out = static_cast<To>(value);
+    return true;
+}
+
+template <typename T>
+bool bind_key_type(const FieldBase *field, KeyIndex::KeyType key_type, KeyIndex::KeyType &out) {
+    if (dynamic_cast<const Field<T> *>(field) == nullptr) {
+        return false;
+    }
+    out = key_type;
+    return true;
+}
+
+}  // namespace key_index_internal
+
+inline std::shared_ptr<KeyIndex> KeyIndex::create(const Record &prototype, const std::string &field_name) {
+    std::vector<size_t> path;
+    const FieldBase *field = resolve_field_path(prototype, field_name, path);
+    if (field == nullptr) {
+        LOG(ERROR) << "key field [" << field_name << "] not exist";
+        return nullptr;
+    }
+    KeyType key_type = kStringKey;
+    if (!key_index_internal::bind_key_type<std::string>(field, kStringKey, key_type) &&
+        !key_index_internal::bind_key_type<int>(field, kIntKey, key_type) &&
+        !key_index_internal::bind_key_type<uint32_t>(field, kUint32Key, key_type) &&
+        !key_index_internal::bind_key_type<uint64_t>(field, kUint64Key, key_type)) {
+        LOG(ERROR) << "key field [" << field_name << "] must be Field<string/int/uint32/uint64>";
+        return nullptr;
+    }
+    switch (key_type) {
+        case kStringKey:
+            return std::make_shared<TypedKeyIndex<StringPiece>>(field_name, path, key_type);
+        case kIntKey:
+            return std::make_shared<TypedKeyIndex<int>>(field_name, path, key_type);
+        case kUint32Key:
+            return std::make_shared<TypedKeyIndex<uint32_t>>(field_name, path, key_type);
+        case kUint64Key:
+            return std::make_shared<TypedKeyIndex<uint64_t>>(field_name, path, key_type);
+    }
+    return nullptr;
+}
+
+template <typename K>
+RowRange KeyIndex::find(const K &key) const {
+    return static_cast<const TypedKeyIndex<K> *>(this)->find(key);
+}
+
+inline RowRange KeyIndex::equal_range(const StringPiece &key) const {
+    switch (key_type_) {
+        case kStringKey:
+            return find(key);
+        case kIntKey: {
+            int value = 0;
+            return parse_integer(key.begin(), key.end(), value) ? find(value) : RowRange();
+        }
+        case kUint32Key: {
+            uint32_t value = 0;
+            return parse_integer(key.begin(), key.end(), value) ? find(value) : RowRange();
+        }
+        case kUint64Key: {
+            uint64_t value = 0;
+            return parse_integer(key.begin(), key.end(), value) ? find(value) : RowRange();
+        }
+    }
+    return RowRange();
+}
+
+template <typename Int>
+typename std::enable_if<std::is_integral<Int>::value, RowRange>::type KeyIndex::equal_range(Int key) const {
+    switch (key_type_) {
+        case kStringKey:
+            return RowRange();
+        case kIntKey: {
+            int value = 0;
+            return key_index_internal::cast_key(key, value) ? find(value) : RowRange();
+        }
+        case kUint32Key: {
+            uint32_t value = 0;
+            return key_index_internal::cast_key(key, value) ? find(value) : RowRange();
+        }
+        case kUint64Key: {
+            uint64_t value = 0;
+            return key_index_internal::cast_key(key, value) ? find(value) : RowRange();
+        }
+    }
+    return RowRange();
+}
+
+}  // namespace dict_field
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "logging.h"
+
+namespace dict_parser {
+
+// MappedFile: 只读 mmap 一个文件, 析构时自动 munmap.
+// 空文件不会真正 mmap, data() 返回 nullptr, size() 返回 0.
+class MappedFile {
+   public:
+    MappedFile() : data_(nullptr), size_(0) {}
+    ~MappedFile() { close(); }
+
+    // st 不为空时, 返回被 mmap 的文件的 fstat 结果
+    bool open(const std::string &filename, struct stat *st = nullptr) {
+        close();
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            LOG(ERROR) << "open file:" << filename << " error";
+            return false;
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0) {
+            LOG(ERROR) << "fstat file:" << filename << " error";
+            ::close(fd);
+            return false;
+        }
+        if (st != nullptr) {
+            *st = file_stat;
+        }
+        size_ = static_cast<size_t>(file_stat.st_size);
+        if (size_ > 0) {
+            void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED) {
+                LOG(ERROR) << "mmap file:" << filename << " error";
+                size_ = 0;
+                ::close(fd);
+                return false;
+            }
+            data_ = static_cast<const char *>(addr);
+            // 字典是顺序扫描的, 提示内核做激进预读
+            madvise(addr, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+        return true;
+    }
+
+    void close() {
+        if (data_ != nullptr) {
+            munmap(const_cast<char *>(data_), size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+   private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    const char *data_;
+    size_t size_;
+};
+
+}  // namespace dict_parser
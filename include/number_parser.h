@@ -0,0 +1,128 @@
+#pragma once
+
+#include <locale.h>
+#if defined(__APPLE__)
+// macOS 的 newlocale/strtof_l 声明在 xlocale.h 中
+#include <xlocale.h>
+#endif
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace dict_field {
+
+// 不抛异常, 不分配内存, 不依赖 locale 的数值解析, 语义接近 std::from_chars.
+// [first, last) 必须整体是一个合法的数值 (允许前导空白), 否则返回 false 且不修改 value.
+
+// parse_integer: 支持可选的 '+'/'-' 前缀, 无符号类型不接受负数; 超出 T 的范围时返回 false
+template <typename T>
+bool parse_integer(const char *first, const char *last, T &value) {
+    static_assert(std::is_integral<T>::value, "parse_integer requires an integral type");
+    while (first < last && (*first == ' ' || *first == '\t' || *first == '\r' || *first == '\n')) {
+        first++;
+    }
+    bool negative = false;
+    if (first < last && (*first == '+' || *first == '-')) {
+        negative = *first == '-';
+        first++;
+    }
+    if (first == last || (negative && !std::is_signed<T>::value)) {
+        return false;
+    }
+
+    typedef typename std::make_unsigned<T>::type UnsignedT;
+    const UnsignedT limit = negative ? static_cast<UnsignedT>(std::numeric_limits<T>::max()) + 1
+                                     : static_cast<UnsignedT>(std::numeric_limits<T>::max());
+    UnsignedT result = 0;
+    for (; first < last; first++) {
+        unsigned digit = static_cast<unsigned char>(*first) - '0';
+        if (digit > 9) {
+            return false;
+        }
+        if (result > (limit - digit) / 10) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    value = negative ? static_cast<T>(0 - result) : static_cast<T>(result);
+    return true;
+}
+
+// parse_float: 十进制的 [+-]digits[.digits][(e|E)[+-]digits].
+// 尾数不超过 2^24 且 10 的指数不超过 10 时可以用一次 float 乘除法得到精确舍入的结果 (Clinger 快速路径);
+// 其余情况 (包括 inf/nan) 拷贝到栈上的缓冲区交给 strtof_l 按 "C" locale 处理, 不受进程 locale 的小数点影响.
+inline bool parse_float(const char *first, const char *last, float &value) {
+    while (first < last && (*first == ' ' || *first == '\t' || *first == '\r' || *first == '\n')) {
+        first++;
+    }
+    const char *begin = first;
+    bool negative = false;
+    if (first < last && (*first == '+' || *first == '-')) {
+        negative = *first == '-';
+        first++;
+    }
+
+    uint64_t mantissa = 0;
+    int num_digits = 0;
+    int exponent = 0;
+    bool fast_path = true;
+    for (; first < last && static_cast<unsigned>(*first - '0') <= 9; first++, num_digits++) {
+        mantissa = mantissa * 10 + (*first - '0');
+    }
+    if (first < last && *first == '.') {
+        first++;
+        for (; first < last && static_cast<unsigned>(*first - '0') <= 9; first++, num_digits++) {
+            mantissa = mantissa * 10 + (*first - '0');
+            exponent--;
+        }
+    }
+    if (num_digits == 0) {
+        fast_path = false;
+    }
+    if (fast_path && first < last && (*first == 'e' || *first == 'E')) {
+        first++;
+        int exp_value = 0;
+        const char *exp_begin = first;
+        if (first < last && (*first == '+' || *first == '-')) first++;
+        const char *exp_digits = first;
+        for (; first < last && static_cast<unsigned>(*first - '0') <= 9; first++) {
+            if (exp_value < 100000) exp_value = exp_value * 10 + (*first - '0');
+        }
+        if (first == exp_digits) {
+            return false;
+        }
+        exponent += *exp_begin == '-' ? -exp_value : exp_value;
+    }
+
+    static const float kPow10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+    if (fast_path && first == last && num_digits <= 19 && mantissa <= (uint64_t(1) << 24) && exponent >= -10 &&
+        exponent <= 10) {
+        float result = static_cast<float>(mantissa);
+        result = exponent < 0 ? result / kPow10[-exponent] : result * kPow10[exponent];
+        value = negative ? -result : result;
+        return true;
+    }
+
+    char buffer[128];
+    size_t len = last - begin;
+    if (len == 0 || len >= sizeof(buffer)) {
+        return false;
+    }
+    memcpy(buffer, begin, len);
+    buffer[len] = '\0';
+    char *end = nullptr;
+    errno = 0;
+    static const locale_t c_locale = newlocale(LC_ALL_MASK, "C", static_cast<locale_t>(0));
+    float result = strtof_l(buffer, &end, c_locale);
+    if (end != buffer + len || errno == ERANGE) {
+        return false;
+    }
+    value = result;
+    return true;
+}
+
+}  // namespace dict_field
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace dict_field {
+
+// 解析失败的原因. 解析热路径上不再打日志, 而是把原因记录在线程局部的 ParseError 中,
+// 由 DictParser 按行汇总 (见 DictParser::set_error_report_mode)
+enum ParseErrorCode {
+    kParseOk = 0,
+    kInvalidInt,
+    kInvalidUint32,
+    kInvalidUint64,
+    kInvalidFloat,
+    kEmptyString,
+    kInvalidCustomType,
+    kFieldCountMismatch,
+    kArrayFormatError,
+    kInvalidArraySize,
+    kArraySizeMismatch,
+    kNumParseErrorCodes
+};
+
+inline const char *parse_error_name(ParseErrorCode code) {
+    static const char *const kNames[kNumParseErrorCodes] = {
+        "ok",           "invalid_int",          "invalid_uint32",      "invalid_uint64",
+        "invalid_float", "empty_string",        "invalid_custom_type", "field_count_mismatch",
+        "array_format_error", "invalid_array_size", "array_size_mismatch"};
+    return code >= 0 && code < kNumParseErrorCodes ? kNames[code] : "unknown";
+}
+
+// ParseError: 记录当前线程最近一次解析失败的原因. 只保留最内层的原因,
+// 外层 field 在内层已经记录过原因时不会覆盖它.
+class ParseError {
+   public:
+    static void set(ParseErrorCode code) {
+        ParseErrorCode &last = last_error();
+        if (last == kParseOk) {
+            last = code;
+        }
+    }
+
+    // take: 取出并清空当前线程记录的原因
+    static ParseErrorCode take() {
+        ParseErrorCode code = last_error();
+        last_error() = kParseOk;
+        return code;
+    }
+
+    // set_field_type: 记录解析失败的 field (或列) 的类型, 与 set 一样只保留最内层
+    static void set_field_type(const std::type_info &field_type) {
+        const std::type_info *&last = last_field_type();
+        if (last == nullptr) {
+            last = &field_type;
+        }
+    }
+
+    // take_field_type: 取出并清空当前线程记录的类型, 没有记录时返回 nullptr
+    static const std::type_info *take_field_type() {
+        const std::type_info *field_type = last_field_type();
+        last_field_type() = nullptr;
+        return field_type;
+    }
+
+    static void reset() {
+        last_error() = kParseOk;
+        last_field_type() = nullptr;
+    }
+
+   private:
+    static const std::type_info *&last_field_type() {
+        static thread_local const std::type_info *field_type = nullptr;
+        return field_type;
+    }
+
+    static ParseErrorCode &last_error() {
+        static thread_local ParseErrorCode code = kParseOk;
+        return code;
+    }
+};
+
+// ParseErrorSummary: 一次 parse_file 的错误汇总, 包括每种原因的次数以及前若干个出错的行号 (从 1 开始)
+struct ParseErrorSummary {
+    ParseErrorSummary() { clear(); }
+
+    void clear() {
+        for (int i = 0; i < kNumParseErrorCodes; i++) {
+            counts[i] = 0;
+        }
+        num_errors = 0;
+        sample_line_numbers.clear();
+    }
+
+    void add(ParseErrorCode code, uint64_t line_number, size_t max_samples) {
+        counts[code]++;
+        num_errors++;
+        if (sample_line_numbers.size() < max_samples) {
+            sample_line_numbers.push_back(line_number);
+        }
+    }
+
+    // merge: line_offset 是 other 中的行号相对于整个文件的偏移, 并行解析按序合并时使用
+    void merge(const ParseErrorSummary &other, uint64_t line_offset, size_t max_samples) {
+        for (int i = 0; i < kNumParseErrorCodes; i++) {
+            counts[i] += other.counts[i];
+        }
+        num_errors += other.num_errors;
+        for (size_t i = 0; i < other.sample_line_numbers.size() && sample_line_numbers.size() < max_samples; i++) {
+            sample_line_numbers.push_back(other.sample_line_numbers[i] + line_offset);
+        }
+    }
+
+    std::string to_string() const {
+        std::string str = "num_errors=" + std::to_string(num_errors);
+        for (int i = 1; i < kNumParseErrorCodes; i++) {
+            if (counts[i] > 0) {
+                str += std::string(", ") + parse_error_name(static_cast<ParseErrorCode>(i)) + "=" +
+                       std::to_string(counts[i]);
+            }
+        }
+        if (!sample_line_numbers.empty()) {
+            str += ", sample_lines=[";
+            for (size_t i = 0; i < sample_line_numbers.size(); i++) {
+                str += (i == 0 ? "" : ",") + std::to_string(sample_line_numbers[i]);
+            }
+            str += "]";
+        }
+        return str;
+    }
+
+    uint64_t counts[kNumParseErrorCodes];
+    uint64_t num_errors;
+    std::vector<uint64_t> sample_line_numbers;
+};
+
+}  // namespace dict_field
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <typeindex>
+#include <typeinfo>
+#include <vector>
+
+#include "demangle.h"
+
+namespace dict_parser {
+
+// LatencyHistogram: HDR 风格的对数-线性直方图, 记录纳秒级耗时.
+// 小于 2^kSubBucketBits 的值每个值一个桶, 更大的值按最高位分组, 每组再线性分成 2^kSubBucketBits 个桶,
+// 所以任意值的相对误差不超过 1/2^kSubBucketBits (约 6%), 内存固定, 记录一次只是几次位运算和一次加法
+class LatencyHistogram {
+   public:
+    LatencyHistogram() : counts_(kNumBuckets, 0) { clear(); }
+
+    void clear() {
+        counts_.assign(kNumBuckets, 0);
+        count_ = 0;
+        sum_ = 0;
+        min_ = UINT64_MAX;
+        max_ = 0;
+    }
+
+    void record(uint64_t value) {
+        counts_[bucket_index(value)]++;
+        count_++;
+        sum_ += value;
+        if (value < min_) min_ = value;
+        if (value > max_) max_ = value;
+    }
+
+    void merge(const LatencyHistogram &other) {
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        if (other.min_ < min_) min_ = other.min_;
+        if (other.max_ > max_) max_ = other.max_;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ == 0 ? 0 : min_; }
+    uint64_t max() const { return max_; }
+    uint64_t sum() const { return sum_; }
+    double mean() const { return count_ == 0 ? 0 : static_cast<double>(sum_) / count_; }
+
+    // percentile: p 取 [0, 100], 返回第 p 百分位所在桶的上界 (不超过 max)
+    uint64_t percentile(double p) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(p / 100 * count_ + 0.5);
+        if (rank < 1) rank = 1;
+        if (rank > count_) rank = count_;
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            cumulative += counts_[i];
+            if (cumulative >= rank) {
+                uint64_t upper = bucket_upper_bound(i);
+                return upper < max_ ? upper : max_;
+            }
+        }
+        return max_;
+    }
+
+    std::string to_string() const {
+        return "count=" + std::to_string(count_) + " mean=" + std::to_string(static_cast<uint64_t>(mean())) +
+               " p50=" + std::to_string(percentile(50)) + " p99=" + std::to_string(percentile(99)) +
+               " p999=" + std::to_string(percentile(99.9)) + " max=" + std::to_string(max());
+    }
+
+   private:
+    static const int kSubBucketBits = 4;
+    static const uint64_t kSubBuckets = 1ULL << kSubBucketBits;
+    static const size_t kNumBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    static size_t bucket_index(uint64_t value) {
+        if (value < kSubBuckets) {
+            return value;
+        }
+        int exponent = 63 - __builtin_clzll(value);
+        uint64_t sub_bucket = (value >> (exponent - kSubBucketBits)) - kSubBuckets;
+        return (exponent - kSubBucketBits + 1) * kSubBuckets + sub_bucket;
+    }
+
+    static uint64_t bucket_upper_bound(size_t index) {
+        if (index < kSubBuckets) {
+            return index;
+        }
+        int exponent = static_cast<int>(index / kSubBuckets) + kSubBucketBits - 1;
+        uint64_t sub_bucket = index % kSubBuckets;
+        int shift = exponent - kSubBucketBits;
+        return ((kSubBuckets + sub_bucket + 1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+// ParseStats: DictParser 的解析统计 (见 DictParser::set_collect_stats).
+//      read_ns: 取得一行的耗时, 即上一行解析结束到本行开始解析之间的时间 (getline / memchr / 解压等);
+//      split_ns: Record 顶层按分隔符切分的耗时, 嵌套 field 的切分计入 parse_ns. 列存模式下切分和解析
+//                在 ParsePlan 中交织执行, 不单独统计;
+//      parse_ns: 解析一行 (包括切分) 的耗时.
+// 并行解析时各线程的统计合并在一起, 所以各阶段耗时之和可能大于 elapsed_ms
+struct ParseStats {
+    ParseStats() { clear(); }
+
+    void clear() {
+        read_ns.clear();
+        split_ns.clear();
+        parse_ns.clear();
+        num_lines = 0;
+        num_bytes = 0;
+        num_records = 0;
+        num_allocs = 0;
+        has_alloc_counter = false;
+        elapsed_ms = 0;
+        field_type_errors.clear();
+    }
+
+    void merge(const ParseStats &other) {
+        read_ns.merge(other.read_ns);
+        split_ns.merge(other.split_ns);
+        parse_ns.merge(other.parse_ns);
+        num_lines += other.num_lines;
+        num_bytes += other.num_bytes;
+        num_records += other.num_records;
+        for (const auto &item : other.field_type_errors) {
+            field_type_errors[item.first] += item.second;
+        }
+    }
+
+    // add_field_type_error: field_type 为最内层解析失败的 field (或列) 的类型, 未知时为 nullptr
+    void add_field_type_error(const std::type_info *field_type) {
+        field_type_errors[field_type != nullptr ? std::type_index(*field_type) : std::type_index(typeid(void))]++;
+    }
+
+    double bytes_per_second() const { return elapsed_ms > 0 ? num_bytes / elapsed_ms * 1000 : 0; }
+    double allocs_per_record() const { return num_records > 0 ? static_cast<double>(num_allocs) / num_records : 0; }
+
+    // field_type_error_counts: 按可读类型名汇总的失败次数, 类型未知时为 "unknown"
+    std::map<std::string, uint64_t> field_type_error_counts() const {
+        std::map<std::string, uint64_t> counts;
+        for (const auto &item : field_type_errors) {
+            counts[item.first == std::type_index(typeid(void)) ? "unknown" : dict_field::demangle(item.first.name())] +=
+                item.second;
+        }
+        return counts;
+    }
+
+    std::string to_string() const {
+        std::string str = "num_lines=" + std::to_string(num_lines) + ", num_records=" + std::to_string(num_records) +
+                          ", num_bytes=" + std::to_string(num_bytes) + ", elapsed_ms=" + std::to_string(elapsed_ms) +
+                          ", bytes_per_second=" + std::to_string(static_cast<uint64_t>(bytes_per_second()));
+        if (has_alloc_counter) {
+            str += ", allocs_per_record=" + std::to_string(allocs_per_record());
+        }
+        str += ", read_ns={" + read_ns.to_string() + "}";
+        if (split_ns.count() > 0) {
+            str += ", split_ns={" + split_ns.to_string() + "}";
+        }
+        str += ", parse_ns={" + parse_ns.to_string() + "}";
+        std::map<std::string, uint64_t> counts = field_type_error_counts();
+        if (!counts.empty()) {
+            str += ", field_type_errors={";
+            for (auto iter = counts.begin(); iter != counts.end(); ++iter) {
+                str += (iter == counts.begin() ? "" : ", ") + iter->first + ":" + std::to_string(iter->second);
+            }
+            str += "}";
+        }
+        return str;
+    }
+
+    LatencyHistogram read_ns;
+    LatencyHistogram split_ns;
+    LatencyHistogram parse_ns;
+    uint64_t num_lines;
+    // 所有行的字节数, 包括换行符
+    uint64_t num_bytes;
+    // 解析成功的行数
+    uint64_t num_records;
+    // 解析期间的堆分配次数, 只有通过 DictParser::set_allocation_counter 提供计数器时才有效
+    uint64_t num_allocs;
+    bool has_alloc_counter;
+    double elapsed_ms;
+    std::map<std::type_index, uint64_t> field_type_errors;
+};
+
+}  // namespace dict_parser
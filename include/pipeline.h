@@ -0,0 +1,256 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "compressed_file.h"
+#include "logging.h"
+
+namespace dict_parser {
+
+// BoundedQueue: 有界的无锁多生产者多消费者队列 (基于每个槽位的序号, 见 Dmitry Vyukov 的 bounded MPMC queue).
+// 容量向上取整到 2 的幂. try_push/try_pop 不阻塞; push/pop 在队列满/空时先自旋让出 CPU, 再退化为短暂 sleep,
+// 避免上游读取很慢 (例如网络文件系统) 时下游线程空转占满 CPU
+template <typename T>
+class BoundedQueue {
+   public:
+    explicit BoundedQueue(size_t capacity) : enqueue_pos_(0), dequeue_pos_(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask_ = size - 1;
+        cells_.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // try_push: 队列满时返回 false, value 保持不变
+    bool try_push(T &value) {
+        Cell *cell = nullptr;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // try_pop: 队列空时返回 false
+    bool try_pop(T &value) {
+        Cell *cell = nullptr;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->data);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(T &value) {
+        for (int spins = 0; !try_push(value); spins++) {
+            backoff(spins);
+        }
+    }
+
+    void pop(T &value) {
+        for (int spins = 0; !try_pop(value); spins++) {
+            backoff(spins);
+        }
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+
+   private:
+    static const int kYieldSpins = 64;
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    static void backoff(int spins) {
+        if (spins < kYieldSpins) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    BoundedQueue(const BoundedQueue &);
+    BoundedQueue &operator=(const BoundedQueue &);
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    // 生产者和消费者的位置放在不同的 cache line 上
+    char pad0_[64];
+    std::atomic<size_t> enqueue_pos_;
+    char pad1_[64];
+    std::atomic<size_t> dequeue_pos_;
+    char pad2_[64];
+};
+
+// BlockReader: 把文件切成以换行符结尾的大块, 最后一块可能没有换行符.
+// 压缩文件 (.gz/.zst) 读出的是解压后的内容
+class BlockReader {
+   public:
+    BlockReader() : fd_(-1), eof_(false) {}
+    ~BlockReader() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    bool open(const std::string &filename) {
+        CompressionType type = compression_type(filename);
+        if (type != kNoCompression) {
+            decompressor_ = Decompressor::create(type);
+            if (!decompressor_) {
+                LOG(ERROR) << "compression format of " << filename << " is not supported";
+                return false;
+            }
+            return decompressor_->open(filename);
+        }
+        fd_ = ::open(filename.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            LOG(ERROR) << "open file:" << filename << " error";
+            return false;
+        }
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        return true;
+    }
+
+    // next: 读出下一块, 块的大小至少为 block_bytes (文件末尾或者单行超过 block_bytes 时除外).
+    // 返回块的字节数, 0 表示文件结束, -1 表示出错
+    int64_t next(std::string &block, size_t block_bytes) {
+        block.clear();
+        block.swap(remainder_);
+        while (!eof_) {
+            size_t old_size = block.size();
+            size_t want = old_size < block_bytes ? block_bytes - old_size : block_bytes;
+            block.resize(old_size + want);
+            int64_t num_bytes = read(&block[old_size], want);
+            if (num_bytes < 0) {
+                return -1;
+            }
+            block.resize(old_size + num_bytes);
+            if (num_bytes == 0) {
+                eof_ = true;
+                break;
+            }
+            if (block.size() < block_bytes) {
+                continue;
+            }
+            // 不完整的最后一行留给下一块, 没有换行符时说明单行超过 block_bytes, 继续读
+            size_t eol = block.rfind('\n');
+            if (eol != std::string::npos) {
+                remainder_.assign(block, eol + 1, std::string::npos);
+                block.resize(eol + 1);
+                break;
+            }
+        }
+        return block.size();
+    }
+
+   private:
+    int64_t read(char *buf, size_t size) {
+        if (decompressor_) {
+            return decompressor_->read(buf, size);
+        }
+        while (true) {
+            ssize_t num_bytes = ::read(fd_, buf, size);
+            if (num_bytes >= 0) {
+                return num_bytes;
+            }
+            if (errno != EINTR) {
+                LOG(ERROR) << "read error: " << strerror(errno);
+                return -1;
+            }
+        }
+    }
+
+    BlockReader(const BlockReader &);
+    BlockReader &operator=(const BlockReader &);
+
+    int fd_;
+    std::unique_ptr<Decompressor> decompressor_;
+    std::string remainder_;
+    bool eof_;
+};
+
+// PipelineStats: 流水线解析各阶段的耗时. *_wait_ms 是该阶段阻塞在队列上的时间:
+// 读取阶段等待得多说明解析跟不上, 解析阶段等待得多说明 I/O 是瓶颈
+struct PipelineStats {
+    PipelineStats() { clear(); }
+
+    void clear() {
+        num_blocks = 0;
+        num_bytes = 0;
+        num_parse_threads = 0;
+        read_ms = 0;
+        read_wait_ms = 0;
+        parse_ms = 0;
+        parse_wait_ms = 0;
+        collect_ms = 0;
+        collect_wait_ms = 0;
+        elapsed_ms = 0;
+    }
+
+    std::string to_string() const {
+        return "num_blocks=" + std::to_string(num_blocks) + ", num_bytes=" + std::to_string(num_bytes) +
+               ", num_parse_threads=" + std::to_string(num_parse_threads) + ", read_ms=" + std::to_string(read_ms) +
+               ", read_wait_ms=" + std::to_string(read_wait_ms) + ", parse_ms=" + std::to_string(parse_ms) +
+               ", parse_wait_ms=" + std::to_string(parse_wait_ms) + ", collect_ms=" + std::to_string(collect_ms) +
+               ", collect_wait_ms=" + std::to_string(collect_wait_ms) + ", elapsed_ms=" + std::to_string(elapsed_ms);
+    }
+
+    uint64_t num_blocks;
+    uint64_t num_bytes;
+    int num_parse_threads;
+    // 读取 (包括解压) 的耗时
+    double read_ms;
+    double read_wait_ms;
+    // 所有解析线程的耗时之和
+    double parse_ms;
+    double parse_wait_ms;
+    // 按原始顺序合并解析结果的耗时
+    double collect_ms;
+    double collect_wait_ms;
+    double elapsed_ms;
+};
+
+}  // namespace dict_parser
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "binary_codec.h"
+#include "field.h"
+#include "logging.h"
+#include "mapped_file.h"
+
+namespace dict_parser {
+
+// 字典快照文件格式:
+//      SnapshotHeader
+//      num_records 条 Record, 每条按 schema 顺序依次写入各个 field 的二进制数据 (见 FieldBase::dump)
+// schema_fingerprint 与当前 schema 不一致的快照会被拒绝加载.
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t schema_fingerprint;
+    uint64_t num_line;
+    uint64_t num_records;
+};
+
+static const char kSnapshotMagic[8] = {'D', 'I', 'C', 'T', 'S', 'N', 'A', 'P'};
+static const uint32_t kSnapshotVersion = 1;
+// 每条 Record 至少写入它的 field 个数 (uint32_t), 用来在加载前检查 num_records 是否可信
+static const size_t kMinSnapshotRecordBytes = sizeof(uint32_t);
+
+inline uint64_t schema_fingerprint(const dict_field::Record &prototype) {
+    std::string signature;
+    prototype.append_signature(signature);
+    return dict_field::fingerprint(signature);
+}
+
+// save_snapshot: 先写临时文件再 rename, 保证读者不会看到写了一半的快照
+inline bool save_snapshot(const std::string &filename, const dict_field::Record &prototype,
+                          const std::vector<std::shared_ptr<dict_field::Record>> &records, uint64_t num_line) {
+    std::string tmp_filename = filename + ".tmp";
+    std::ofstream ofile(tmp_filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofile) {
+        LOG(ERROR) << "open file:" << tmp_filename << " error";
+        return false;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+    header.version = kSnapshotVersion;
+    header.schema_fingerprint = schema_fingerprint(prototype);
+    header.num_line = num_line;
+    header.num_records = records.size();
+    ofile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    const size_t kFlushBytes = 1 << 20;
+    std::string buffer;
+    dict_field::BinaryWriter writer(&buffer);
+    for (const auto &record : records) {
+        if (!record->dump(writer)) {
+            LOG(ERROR) << "record can not be dumped to snapshot, unsupported field type";
+            ofile.close();
+            remove(tmp_filename.c_str());
+            return false;
+        }
+        if (buffer.size() >= kFlushBytes) {
+            ofile.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    ofile.write(buffer.data(), buffer.size());
+    ofile.close();
+    if (!ofile || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        LOG(ERROR) << "write snapshot:" << filename << " error";
+        remove(tmp_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+// load_snapshot: mmap 快照文件并按 record_template 还原所有 Record
+inline bool load_snapshot(const std::string &filename, const dict_field::RecordTemplate &record_template,
+                          std::vector<std::shared_ptr<dict_field::Record>> &records, uint64_t &num_line) {
+    MappedFile mapped_file;
+    if (!mapped_file.open(filename)) {
+        return false;
+    }
+    dict_field::BinaryReader reader(mapped_file.data(), mapped_file.size());
+    SnapshotHeader header;
+    if (!reader.read_pod(header) || memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+        header.version != kSnapshotVersion) {
+        LOG(ERROR) << "snapshot:" << filename << " bad header";
+        return false;
+    }
+    // 损坏或截断的快照中 num_records 可能非常大, 直接 reserve 会抛出 length_error/bad_alloc
+    if (header.num_records > (mapped_file.size() - sizeof(header)) / kMinSnapshotRecordBytes) {
+        LOG(ERROR) << "snapshot:" << filename << " bad header, num_records:" << header.num_records
+                   << " exceeds file size";
+        return false;
+    }
+    if (header.schema_fingerprint != schema_fingerprint(*record_template.prototype())) {
+        LOG(ERROR) << "snapshot:" << filename << " schema mismatch, snapshot is stale";
+        return false;
+    }
+
+    std::vector<std::shared_ptr<dict_field::Record>> loaded;
+    loaded.reserve(header.num_records);
+    for (uint64_t i = 0; i < header.num_records; i++) {
+        std::shared_ptr<dict_field::Record> record = record_template.new_record();
+        if (!record->load(reader)) {
+            LOG(ERROR) << "snapshot:" << filename << " corrupted at record " << i;
+            return false;
+        }
+        loaded.push_back(record);
+    }
+    if (!reader.eof()) {
+        LOG(ERROR) << "snapshot:" << filename << " has trailing bytes";
+        return false;
+    }
+    records.swap(loaded);
+    num_line = header.num_line;
+    return true;
+}
+
+}  // namespace dict_parser
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "logging.h"
+#include "mapped_file.h"
+#include "parse_error.h"
+#include "static_schema.h"
+
+namespace dict_parser {
+
+// StaticDictParser: 使用编译期 schema (见 static_schema.h) 解析字典文件, 每一行解析为一个 Schema::value_type.
+// 文件总是以 mmap 的方式读取, 解析失败的行不打日志, 按原因汇总到 error_summary() 中
+template <typename Schema>
+class StaticDictParser {
+   public:
+    typedef typename Schema::value_type value_type;
+
+    explicit StaticDictParser(const std::string& filename)
+        : filename_(filename), num_line_(0), num_succ_parsed_line_(0), max_error_samples_(10) {}
+
+    void set_max_error_samples(size_t max_error_samples) { max_error_samples_ = max_error_samples; }
+
+    bool parse_file() {
+        this->clear();
+        MappedFile mapped_file;
+        if (!mapped_file.open(filename_)) {
+            return false;
+        }
+        const char* cur = mapped_file.data();
+        const char* end = cur + mapped_file.size();
+        // 解析成功时 row 的每个字段都会被重新赋值, 所以 move 之后可以直接复用
+        value_type row;
+        while (cur < end) {
+            const char* eol = static_cast<const char*>(memchr(cur, '\n', end - cur));
+            if (eol == nullptr) {
+                eol = end;
+            }
+            num_line_++;
+            dict_field::ParseError::reset();
+            if (Schema::parse(dict_field::StringPiece(cur, eol - cur), row)) {
+                parsed_result_.push_back(std::move(row));
+                num_succ_parsed_line_++;
+            } else {
+                error_summary_.add(dict_field::ParseError::take(), num_line_, max_error_samples_);
+            }
+            cur = eol + 1;
+        }
+        if (error_summary_.num_errors > 0) {
+            LOG(WARNING) << "parse " << filename_ << " done, " << error_summary_.to_string();
+        }
+        return true;
+    }
+
+    void clear() {
+        parsed_result_.clear();
+        error_summary_.clear();
+        num_line_ = 0;
+        num_succ_parsed_line_ = 0;
+    }
+
+    uint64_t num_line() const { return num_line_; }
+    uint64_t num_succ_parsed_line() const { return num_succ_parsed_line_; }
+    const std::vector<value_type>& parsed_result() const { return parsed_result_; }
+    const dict_field::ParseErrorSummary& error_summary() const { return error_summary_; }
+
+   private:
+    std::string filename_;
+    std::vector<value_type> parsed_result_;
+    uint64_t num_line_;
+    uint64_t num_succ_parsed_line_;
+    size_t max_error_samples_;
+    dict_field::ParseErrorSummary error_summary_;
+};
+
+}  // namespace dict_parser
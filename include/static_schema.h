@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "field.h"
+#include "parse_error.h"
+#include "string_piece.h"
+
+namespace dict_field {
+
+// 编译期 schema: 用模板参数描述一行的结构, 解析结果直接写入 std::tuple, 没有 Record/Field 对象树,
+// 也没有虚函数调用. 例如 main.cc 中 record_builder_func 对应的 schema 为:
+//      typedef RecordSchema<Field<std::string>, Field<uint32_t>, Field<int>, ArrayField<Field<std::string>>,
+//                           Nested<',', Field<int>, Field<int>>> PeopleSchema;
+//      PeopleSchema::value_type row;   // std::tuple<std::string, uint32_t, int, std::vector<std::string>,
+//                                      //            std::tuple<int, int>>
+//      PeopleSchema::parse(line, row);
+// 支持的字段类型:
+//      Field<T>: 值类型为 T, T 需要有对应的 parse 特化或者自定义的 parse 方法
+//      ArrayField<Field<T>>: "N:a,b,c" 格式, 值类型为 std::vector<T>
+//      Nested<Delim, Fields...>: 以 Delim 分隔的嵌套结构, 值类型为 std::tuple
+// 切分规则与运行时的 Record 一致: 连续的分隔符视为一个, 字段个数不一致视为解析失败.
+// 由表头文件决定 schema 的场景仍然使用运行时的 Record.
+
+template <char Delim, typename... Fields>
+struct Nested;
+
+// StaticFieldTraits: 每种字段类型的值类型和解析函数
+template <typename FieldT>
+struct StaticFieldTraits;
+
+template <typename T>
+struct StaticFieldTraits<Field<T>> {
+    typedef T value_type;
+    static bool parse(const StringPiece &inp, value_type &value) { return dict_field::parse(inp, value); }
+};
+
+template <typename T>
+struct StaticFieldTraits<ArrayField<Field<T>>> {
+    typedef std::vector<T> value_type;
+    static bool parse(const StringPiece &inp, value_type &value) {
+        static const std::string delim(",");
+        SplitBufferPool::Guard guard;
+        std::vector<StringPiece> &items = guard.buffer();
+        if (!array_splitter(inp, delim, items)) {
+            return false;
+        }
+        value.resize(items.size());
+        for (size_t i = 0; i < items.size(); i++) {
+            if (!dict_field::parse(items[i], value[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+template <char Delim, typename... Fields>
+struct StaticFieldTraits<Nested<Delim, Fields...>> {
+    typedef typename Nested<Delim, Fields...>::value_type value_type;
+    static bool parse(const StringPiece &inp, value_type &value) { return Nested<Delim, Fields...>::parse(inp, value); }
+};
+
+// StaticTokenizer: 逐个取出以 delim 分隔的非空 token, 不需要先切分到 vector 中
+class StaticTokenizer {
+   public:
+    StaticTokenizer(const StringPiece &inp, char delim) : cur_(inp.begin()), end_(inp.end()), delim_(delim) {}
+
+    bool next(StringPiece &token) {
+        while (cur_ < end_ && *cur_ == delim_) {
+            cur_++;
+        }
+        if (cur_ == end_) {
+            return false;
+        }
+        const char *eot = static_cast<const char *>(memchr(cur_, delim_, end_ - cur_));
+        if (eot == nullptr) {
+            eot = end_;
+        }
+        token = StringPiece(cur_, eot - cur_);
+        cur_ = eot;
+        return true;
+    }
+
+   private:
+    const char *cur_;
+    const char *end_;
+    char delim_;
+};
+
+// StaticTupleParser: 按下标递归展开, 依次解析 tuple 的第 I 到第 N - 1 个元素
+template <size_t I, size_t N, typename... Fields>
+struct StaticTupleParser {
+    typedef typename std::tuple_element<I, std::tuple<Fields...>>::type FieldT;
+
+    template <typename Tuple>
+    static bool parse(StaticTokenizer &tokenizer, Tuple &value) {
+        StringPiece token;
+        if (!tokenizer.next(token)) {
+            ParseError::set(kFieldCountMismatch);
+            return false;
+        }
+        return StaticFieldTraits<FieldT>::parse(token, std::get<I>(value)) &&
+               StaticTupleParser<I + 1, N, Fields...>::parse(tokenizer, value);
+    }
+};
+
+template <size_t N, typename... Fields>
+struct StaticTupleParser<N, N, Fields...> {
+    template <typename Tuple>
+    static bool parse(StaticTokenizer &tokenizer, Tuple &) {
+        StringPiece token;
+        if (tokenizer.next(token)) {
+            ParseError::set(kFieldCountMismatch);
+            return false;
+        }
+        return true;
+    }
+};
+
+template <char Delim, typename... Fields>
+struct Nested {
+    typedef std::tuple<typename StaticFieldTraits<Fields>::value_type...> value_type;
+
+    static const size_t kNumFields = sizeof...(Fields);
+
+    // parse: 解析失败时 value 中可能残留部分字段的结果, 失败原因记录在 ParseError 中
+    static bool parse(const StringPiece &inp, value_type &value) {
+        StaticTokenizer tokenizer(inp, Delim);
+        return StaticTupleParser<0, sizeof...(Fields), Fields...>::parse(tokenizer, value);
+    }
+};
+
+// RecordSchema: 一整行, 字段之间以 '\t' 分隔
+template <typename... Fields>
+struct RecordSchema : public Nested<'\t', Fields...> {};
+
+}  // namespace dict_field
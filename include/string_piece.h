@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace dict_field {
+
+// StringPiece: 指向一段外部内存的只读切片, 不拥有数据, 也不做拷贝.
+// 调用方需要保证切片的生命周期不超过底层数据 (std::string / mmap 区域) 的生命周期.
+class StringPiece {
+   public:
+    StringPiece() : data_(nullptr), size_(0) {}
+    StringPiece(const char *data, size_t size) : data_(data), size_(size) {}
+    StringPiece(const char *str) : data_(str), size_(str == nullptr ? 0 : strlen(str)) {}
+    StringPiece(const std::string &str) : data_(str.data()), size_(str.size()) {}
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const char *begin() const { return data_; }
+    const char *end() const { return data_ + size_; }
+    char operator[](size_t i) const { return data_[i]; }
+
+    std::string as_string() const { return std::string(data_, size_); }
+
+    bool operator==(const StringPiece &other) const {
+        return size_ == other.size_ && (size_ == 0 || memcmp(data_, other.data_, size_) == 0);
+    }
+    bool operator!=(const StringPiece &other) const { return !(*this == other); }
+
+   private:
+    const char *data_;
+    size_t size_;
+};
+
+inline std::ostream &operator<<(std::ostream &os, const StringPiece &piece) {
+    return os.write(piece.data(), piece.size());
+}
+
+}  // namespace dict_field
@@ -0,0 +1,322 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "binary_codec.h"
+#include "string_piece.h"
+
+namespace dict_field {
+
+// StringPieceHash: 64 位 FNV-1a, 用于以 StringPiece 为 key 的哈希表
+struct StringPieceHash {
+    size_t operator()(const StringPiece &str) const {
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < str.size(); i++) {
+            hash ^= static_cast<unsigned char>(str[i]);
+            hash *= 1099511628211ULL;
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+// StringPool: 字符串驻留池, 把字符串映射成从 0 开始连续分配的 32 位 id, 相同的字符串只存一份.
+// 字符串内容按块存放, 返回的 StringPiece 在池的生命周期内一直有效.
+// 线程安全, 供并行解析的多个线程同时使用:
+//      - 按哈希值分成 num_shards 个分片, 每个分片是一个开放寻址的哈希表, 只存 (哈希标签, id);
+//      - 查找不加锁: 哈希表的槽位是原子的 64 位整数, 扩容时发布新表, 旧表保留到池析构;
+//      - 插入只锁对应的分片, 在锁内再查一次后从全局计数器分配 id, 所以 id 连续且不会重复;
+//      - id -> 字符串是按 2 的幂增长的分段数组, 已分配的段不会移动, str() 不加锁.
+class StringPool {
+   public:
+    explicit StringPool(size_t num_shards = kDefaultShards) : next_id_(0) {
+        size_t size = 1;
+        while (size < num_shards) {
+            size <<= 1;
+        }
+        shard_mask_ = size - 1;
+        for (size_t i = 0; i < size; i++) {
+            shards_.emplace_back(new Shard());
+        }
+        for (size_t i = 0; i < kNumSegments; i++) {
+            segments_[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~StringPool() {
+        for (size_t i = 0; i < kNumSegments; i++) {
+            delete[] segments_[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    // intern: 返回 str 的 id, 第一次出现时分配新的 id
+    uint32_t intern(const StringPiece &str) {
+        uint64_t hash = StringPieceHash()(str);
+        Shard &shard = *shards_[hash & shard_mask_];
+        uint32_t id = 0;
+        if (lookup(shard, hash, str, id)) {
+            return id;
+        }
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (lookup(shard, hash, str, id)) {
+            return id;
+        }
+        return insert(shard, hash, str);
+    }
+
+    // find: 只查找不插入, str 不在池中时返回 false
+    bool find(const StringPiece &str, uint32_t &id) const {
+        uint64_t hash = StringPieceHash()(str);
+        Shard &shard = *shards_[hash & shard_mask_];
+        if (lookup(shard, hash, str, id)) {
+            return true;
+        }
+        // 无锁查找可能与扩容交错而错过刚插入的字符串, 在锁内确认
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return lookup(shard, hash, str, id);
+    }
+
+    // str: id 必须由本池分配, 并且分配它的 intern 调用对当前线程可见
+    StringPiece str(uint32_t id) const {
+        size_t segment = 0;
+        size_t offset = 0;
+        locate(id, segment, offset);
+        return segments_[segment].load(std::memory_order_acquire)[offset];
+    }
+
+    // size: 已分配的 id 个数. 与 intern 并发调用时, 最后几个 id 的 str() 可能还不可见
+    size_t size() const { return next_id_.load(std::memory_order_acquire); }
+
+    // bytes: 字符串内容占用的字节数, 不包括哈希表
+    size_t bytes() const {
+        size_t num_bytes = 0;
+        for (const auto &shard : shards_) {
+            num_bytes += shard->num_bytes.load(std::memory_order_relaxed);
+        }
+        return num_bytes;
+    }
+
+    size_t num_shards() const { return shards_.size(); }
+
+    // Scope: 在当前线程内指定 parse<InternedString> 使用的池, 析构时恢复之前的池
+    class Scope {
+       public:
+        explicit Scope(StringPool *pool) : prev_(current_ref()) { current_ref() = pool; }
+        ~Scope() { current_ref() = prev_; }
+
+       private:
+        Scope(const Scope &);
+        Scope &operator=(const Scope &);
+
+        StringPool *prev_;
+    };
+
+    // current: 当前线程的池, 没有通过 Scope 指定时为全局默认池
+    static StringPool *current() {
+        StringPool *pool = current_ref();
+        return pool != nullptr ? pool : default_pool();
+    }
+
+    static StringPool *default_pool() {
+        static StringPool pool;
+        return &pool;
+    }
+
+   private:
+    static const size_t kDefaultShards = 64;
+    static const size_t kBlockBytes = 64 << 10;
+    static const size_t kInitialSlots = 64;
+    // 第 k 段有 2^(kFirstSegmentBits + k) 个 id, 共 kNumSegments 段, 覆盖全部 32 位 id
+    static const size_t kFirstSegmentBits = 10;
+    static const size_t kNumSegments = 32 - kFirstSegmentBits + 1;
+    // 空槽位. 非空槽位高 32 位是哈希标签, 低 32 位是 id
+    static const uint64_t kEmptySlot = ~0ULL;
+
+    struct Table {
+        explicit Table(size_t num_slots) : mask(num_slots - 1), slots(new std::atomic<uint64_t>[num_slots]) {
+            for (size_t i = 0; i < num_slots; i++) {
+                slots[i].store(kEmptySlot, std::memory_order_relaxed);
+            }
+        }
+        size_t mask;
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+    };
+
+    // Shard: 一个分片. 只有持有 mutex 的线程会修改它, 读 table 不需要加锁
+    struct Shard {
+        Shard() : table(nullptr), num_entries(0), num_bytes(0), cur(nullptr), end(nullptr) {
+            tables.emplace_back(new Table(kInitialSlots));
+            table.store(tables.back().get(), std::memory_order_relaxed);
+        }
+
+        std::mutex mutex;
+        std::atomic<Table *> table;
+        // 当前表以及扩容后保留的旧表, 保证并发的无锁查找不会访问已释放的内存
+        std::vector<std::unique_ptr<Table>> tables;
+        size_t num_entries;
+        std::atomic<size_t> num_bytes;
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char *cur;
+        char *end;
+        // 分片之间隔开一个 cache line, 避免插入时的伪共享
+        char pad[64];
+    };
+
+    static StringPool *&current_ref() {
+        static thread_local StringPool *pool = nullptr;
+        return pool;
+    }
+
+    static uint64_t make_slot(uint64_t hash, uint32_t id) { return (hash & 0xffffffff00000000ULL) | id; }
+
+    // locate: id 在分段数组中的位置
+    static void locate(uint32_t id, size_t &segment, size_t &offset) {
+        uint64_t pos = static_cast<uint64_t>(id) + (1ULL << kFirstSegmentBits);
+        size_t bits = 63 - __builtin_clzll(pos);
+        segment = bits - kFirstSegmentBits;
+        offset = pos - (1ULL << bits);
+    }
+
+    bool lookup(const Shard &shard, uint64_t hash, const StringPiece &key, uint32_t &id) const {
+        const Table *table = shard.table.load(std::memory_order_acquire);
+        uint64_t tag = hash & 0xffffffff00000000ULL;
+        // 分片已经用掉了哈希值的低位, 用高位做槽位下标
+        for (size_t i = (hash >> 32) & table->mask;; i = (i + 1) & table->mask) {
+            uint64_t slot = table->slots[i].load(std::memory_order_acquire);
+            if (slot == kEmptySlot) {
+                return false;
+            }
+            if ((slot & 0xffffffff00000000ULL) == tag && str(static_cast<uint32_t>(slot)) == key) {
+                id = static_cast<uint32_t>(slot);
+                return true;
+            }
+        }
+    }
+
+    // insert: 调用方持有 shard.mutex, 并且已经确认 str 不在池中
+    uint32_t insert(Shard &shard, uint64_t hash, const StringPiece &str) {
+        Table *table = shard.table.load(std::memory_order_relaxed);
+        // 负载因子保持在 1/2 以下, 保证探测序列很短并且总能遇到空槽位
+        if ((shard.num_entries + 1) * 2 > table->mask + 1) {
+            table = grow(shard, *table);
+        }
+        uint32_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+        set_str(id, store(shard, str));
+        place(*table, make_slot(hash, id));
+        shard.num_entries++;
+        return id;
+    }
+
+    // place: release 保证读到这个槽位的线程也能看到 id 对应的字符串
+    static void place(Table &table, uint64_t slot) {
+        size_t i = (slot >> 32) & table.mask;
+        while (table.slots[i].load(std::memory_order_relaxed) != kEmptySlot) {
+            i = (i + 1) & table.mask;
+        }
+        table.slots[i].store(slot, std::memory_order_release);
+    }
+
+    Table *grow(Shard &shard, const Table &old_table) {
+        Table *table = new Table((old_table.mask + 1) * 2);
+        for (size_t i = 0; i <= old_table.mask; i++) {
+            uint64_t slot = old_table.slots[i].load(std::memory_order_relaxed);
+            if (slot != kEmptySlot) {
+                place(*table, slot);
+            }
+        }
+        shard.tables.emplace_back(table);
+        shard.table.store(table, std::memory_order_release);
+        return table;
+    }
+
+    void set_str(uint32_t id, const StringPiece &stored) {
+        size_t segment = 0;
+        size_t offset = 0;
+        locate(id, segment, offset);
+        StringPiece *pieces = segments_[segment].load(std::memory_order_acquire);
+        if (pieces == nullptr) {
+            // 多个分片可能同时需要同一个新段, 只有一个线程的分配会生效
+            StringPiece *new_pieces = new StringPiece[1ULL << (kFirstSegmentBits + segment)];
+            if (segments_[segment].compare_exchange_strong(pieces, new_pieces, std::memory_order_acq_rel)) {
+                pieces = new_pieces;
+            } else {
+                delete[] new_pieces;
+            }
+        }
+        pieces[offset] = stored;
+    }
+
+    static StringPiece store(Shard &shard, const StringPiece &str) {
+        shard.num_bytes.fetch_add(str.size(), std::memory_order_relaxed);
+        // 长字符串单独占一个块
+        if (str.size() > kBlockBytes / 4) {
+            shard.blocks.emplace_back(new char[str.size()]);
+            memcpy(shard.blocks.back().get(), str.data(), str.size());
+            return StringPiece(shard.blocks.back().get(), str.size());
+        }
+        if (shard.cur == nullptr || static_cast<size_t>(shard.end - shard.cur) < str.size()) {
+            shard.blocks.emplace_back(new char[kBlockBytes]);
+            shard.cur = shard.blocks.back().get();
+            shard.end = shard.cur + kBlockBytes;
+        }
+        memcpy(shard.cur, str.data(), str.size());
+        StringPiece stored(shard.cur, str.size());
+        shard.cur += str.size();
+        return stored;
+    }
+
+    StringPool(const StringPool &);
+    StringPool &operator=(const StringPool &);
+
+    size_t shard_mask_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic<uint32_t> next_id_;
+    std::atomic<StringPiece *> segments_[kNumSegments];
+};
+
+// InternedString: 驻留后的字符串, 只存 32 位 id. 同一个池中的两个字符串相等当且仅当 id 相等.
+// 通过 Field<InternedString> / ArrayField<Field<InternedString>> / FlatArrayField<InternedString> 使用,
+// 解析时写入 StringPool::current(), 读取内容需要通过同一个池, 例如 dictparser.string_pool()->str(id)
+struct InternedString {
+    static const uint32_t kNoId = 0xffffffffu;
+
+    InternedString() : id(kNoId) {}
+    explicit InternedString(uint32_t id) : id(id) {}
+
+    bool operator==(const InternedString &other) const { return id == other.id; }
+    bool operator!=(const InternedString &other) const { return id != other.id; }
+
+    uint32_t id;
+};
+
+// 快照中写入字符串内容而不是 id, 读取时重新驻留到 StringPool::current(), 所以快照与池无关
+template <>
+struct BinaryCodec<InternedString> {
+    static bool write(BinaryWriter &writer, const InternedString &value) {
+        StringPiece str;
+        if (value.id != InternedString::kNoId) {
+            str = StringPool::current()->str(value.id);
+        }
+        writer.write_pod(static_cast<uint32_t>(str.size()));
+        writer.write_bytes(str.data(), str.size());
+        return true;
+    }
+    static bool read(BinaryReader &reader, InternedString &value) {
+        uint32_t size = 0;
+        const char *data = nullptr;
+        if (!reader.read_pod(size) || !reader.read_view(data, size)) return false;
+        value = InternedString();
+        if (size > 0) {
+            value.id = StringPool::current()->intern(StringPiece(data, size));
+        }
+        return true;
+    }
+    static size_t min_bytes() { return sizeof(uint32_t); }
+};
+
+}  // namespace dict_field
@@ -1,13 +1,25 @@
 #include <gtest/gtest.h>
+#include <zlib.h>
 
+#include <atomic>
+#include <clocale>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <string>
+#include <thread>
 #include <tuple>
 
+#include "../include/dict_loader.h"
 #include "../include/dict_parser.h"
+#include "../include/dict_reloader.h"
 #include "../include/field.h"
+#include "../include/field_handle.h"
 #include "../include/logging.h"
+#include "../include/static_dict_parser.h"
 
 using namespace dict_field;
 using namespace dict_parser;
@@ -145,6 +157,43 @@ TEST(GoodCoderTest, DIYStruct) {
     EXPECT_EQ(infofield->data().name, "wangwu");
 }
 
+// 直接继承 FieldBase 的自定义 field, 通过 ClonableField 获得 clone_to
+class UpperCaseField : public ClonableField<UpperCaseField> {
+   public:
+    explicit UpperCaseField(const std::string& name) : ClonableField<UpperCaseField>(name) {}
+    bool deserilization(const StringPiece& inp) override {
+        data_.assign(inp.data(), inp.size());
+        for (auto& c : data_) {
+            c = toupper(c);
+        }
+        return true;
+    }
+    const std::string& data() const { return data_; }
+
+   private:
+    std::string data_;
+};
+
+class NoCloneField : public FieldBase {
+   public:
+    explicit NoCloneField(const std::string& name) : FieldBase(name) {}
+    bool deserilization(const StringPiece&) override { return true; }
+};
+
+TEST(GoodCoderTest, CustomFieldClone) {
+    std::shared_ptr<Record> prototype = std::make_shared<Record>();
+    prototype->add_field(std::make_shared<Field<int>>("id"));
+    prototype->add_field(std::make_shared<UpperCaseField>("name"));
+    RecordTemplate record_template(prototype);
+    std::shared_ptr<Record> record = record_template.new_record();
+    ASSERT_TRUE(record->deserilization("1\twangwu"));
+    EXPECT_EQ(static_cast<UpperCaseField*>(record->get_field_ptr("name"))->data(), "WANGWU");
+    EXPECT_EQ(static_cast<UpperCaseField*>(prototype->get_field_ptr("name"))->data(), "");
+
+    NoCloneField no_clone("no_clone");
+    EXPECT_DEATH(no_clone.clone(), "NoCloneField does not implement clone_to");
+}
+
 std::shared_ptr<Record> record_builder_func() {
     std::shared_ptr<Record> record = std::make_shared<Record>();
     record->add_field(std::make_shared<Field<std::string>>("name"));
@@ -191,3 +240,1058 @@ TEST(GoodCoderTest, DictParserWithHeaderFile) {
     EXPECT_EQ(name_field_first_succ_line->data(), "yinpeng");
     EXPECT_EQ(name_field_second_succ_line->data(), "dengyuting");
 }
+
+TEST(GoodCoderTest, DictParserWithMmap) {
+    DictParser dictparser("datas/demo.txt", record_builder_func);
+    dictparser.set_use_mmap(true);
+    ASSERT_TRUE(dictparser.parse_file());
+
+    EXPECT_EQ(dictparser.num_line(), 3);
+    EXPECT_EQ(dictparser.num_succ_parsed_line(), 2);
+    ASSERT_EQ(dictparser.parsed_result().size(), 2);
+    std::shared_ptr<Field<std::string>> name_field_first_succ_line =
+        std::dynamic_pointer_cast<Field<std::string>>(dictparser.parsed_result()[0]->get_field("name"));
+    std::shared_ptr<ArrayField<Field<std::string>>> items_field =
+        std::dynamic_pointer_cast<ArrayField<Field<std::string>>>(dictparser.parsed_result()[1]->get_field("items"));
+
+    EXPECT_EQ(name_field_first_succ_line->data(), "dengyuting");
+    EXPECT_EQ(items_field->sub_fields_at(1)->data(), "cs");
+}
+
+TEST(GoodCoderTest, DictParserParallel) {
+    std::string filename = testing::TempDir() + "parallel_demo.txt";
+    std::ifstream demo("datas/demo.txt");
+    std::string demo_content((std::istreambuf_iterator<char>(demo)), std::istreambuf_iterator<char>());
+    std::ofstream ofile(filename);
+    for (int i = 0; i < 1000; i++) {
+        ofile << demo_content;
+    }
+    ofile.close();
+
+    DictParser serial_parser(filename, record_builder_func);
+    ASSERT_TRUE(serial_parser.parse_file());
+
+    DictParser parallel_parser(filename, record_builder_func);
+    parallel_parser.set_num_threads(7);
+    ASSERT_TRUE(parallel_parser.parse_file());
+
+    EXPECT_EQ(parallel_parser.num_line(), 3000);
+    EXPECT_EQ(parallel_parser.num_succ_parsed_line(), 2000);
+    ASSERT_EQ(parallel_parser.parsed_result().size(), serial_parser.parsed_result().size());
+    for (size_t i = 0; i < serial_parser.parsed_result().size(); i++) {
+        std::shared_ptr<Field<std::string>> serial_name =
+            std::dynamic_pointer_cast<Field<std::string>>(serial_parser.parsed_result()[i]->get_field("name"));
+        std::shared_ptr<Field<std::string>> parallel_name =
+            std::dynamic_pointer_cast<Field<std::string>>(parallel_parser.parsed_result()[i]->get_field("name"));
+        ASSERT_EQ(serial_name->data(), parallel_name->data());
+    }
+
+    DictParser columnar_parser(filename, record_builder_func);
+    columnar_parser.set_num_threads(7);
+    columnar_parser.set_columnar(true);
+    ASSERT_TRUE(columnar_parser.parse_file());
+    std::shared_ptr<const ValueColumn<std::string>> names =
+        columnar_parser.column_store()->typed_column<ValueColumn<std::string>>("name");
+    ASSERT_EQ(names->size(), 2000);
+    EXPECT_EQ(names->at(1998), "dengyuting");
+    EXPECT_EQ(names->at(1999), "yinpeng");
+}
+
+TEST(GoodCoderTest, RecordTemplate) {
+    RecordTemplate record_template(record_builder_func());
+    std::shared_ptr<Record> first = record_template.new_record();
+    std::shared_ptr<Record> second = record_template.new_record();
+    ASSERT_TRUE(first->deserilization("yinpeng\t18\t180\t3:math,cs,physis\t100,10"));
+    ASSERT_TRUE(second->deserilization("dengyuting\t18\t183\t2:math,cs\t200,150"));
+
+    EXPECT_EQ(record_template.prototype()->num_fields(), 5);
+    EXPECT_EQ(std::dynamic_pointer_cast<Field<std::string>>(first->get_field("name"))->data(), "yinpeng");
+    EXPECT_EQ(std::dynamic_pointer_cast<Field<std::string>>(second->get_field("name"))->data(), "dengyuting");
+    EXPECT_EQ(std::dynamic_pointer_cast<ArrayField<Field<std::string>>>(first->get_field("items"))->num_fields(), 3);
+    EXPECT_EQ(std::dynamic_pointer_cast<ArrayField<Field<std::string>>>(second->get_field("items"))->num_fields(), 2);
+    std::shared_ptr<NestedField> money = std::dynamic_pointer_cast<NestedField>(second->get_field("money"));
+    EXPECT_EQ(std::dynamic_pointer_cast<Field<int>>(money->get_field("expensis"))->data(), 150);
+}
+
+TEST(GoodCoderTest, DictParserColumnar) {
+    DictParser dictparser("datas/demo.txt", record_builder_func);
+    dictparser.set_columnar(true);
+    ASSERT_TRUE(dictparser.parse_file());
+
+    EXPECT_EQ(dictparser.num_line(), 3);
+    EXPECT_EQ(dictparser.num_succ_parsed_line(), 2);
+    EXPECT_TRUE(dictparser.parsed_result().empty());
+    std::shared_ptr<const ColumnStore> column_store = dictparser.column_store();
+    ASSERT_EQ(column_store->num_rows(), 2);
+
+    std::shared_ptr<const ValueColumn<std::string>> names = column_store->typed_column<ValueColumn<std::string>>("name");
+    std::shared_ptr<const ValueColumn<int>> heights = column_store->typed_column<ValueColumn<int>>("height");
+    std::shared_ptr<const ArrayColumn<std::string>> items =
+        column_store->typed_column<ArrayColumn<std::string>>("items");
+    std::shared_ptr<const ValueColumn<int>> expensis = column_store->typed_column<ValueColumn<int>>("money.expensis");
+    ASSERT_TRUE(names && heights && items && expensis);
+
+    // 第一行解析失败, 不能在任何一列留下数据
+    ASSERT_EQ(names->size(), 2);
+    EXPECT_EQ(names->at(0), "dengyuting");
+    EXPECT_EQ(names->at(1), "yinpeng");
+    EXPECT_EQ(heights->values(), std::vector<int>({183, 183}));
+    EXPECT_EQ(items->array_size(0), 2);
+    EXPECT_EQ(items->values().at(3), "cs");
+    EXPECT_EQ(expensis->at(1), 150);
+    EXPECT_EQ(column_store->column("money")->size(), 2);
+}
+
+TEST(GoodCoderTest, NumberParser) {
+    int int_value = 0;
+    EXPECT_TRUE(dict_field::parse(StringPiece("-2147483648"), int_value));
+    EXPECT_EQ(int_value, std::numeric_limits<int>::min());
+    EXPECT_FALSE(dict_field::parse(StringPiece("2147483648"), int_value));
+    EXPECT_FALSE(dict_field::parse(StringPiece("12abc"), int_value));
+    EXPECT_FALSE(dict_field::parse(StringPiece(""), int_value));
+
+    uint32_t uint32_value = 0;
+    EXPECT_TRUE(dict_field::parse(StringPiece("4294967295"), uint32_value));
+    EXPECT_EQ(uint32_value, 4294967295u);
+    EXPECT_FALSE(dict_field::parse(StringPiece("4294967296"), uint32_value));
+    EXPECT_FALSE(dict_field::parse(StringPiece("-1"), uint32_value));
+
+    uint64_t uint64_value = 0;
+    EXPECT_TRUE(dict_field::parse(StringPiece("18446744073709551615"), uint64_value));
+    EXPECT_EQ(uint64_value, std::numeric_limits<uint64_t>::max());
+    EXPECT_FALSE(dict_field::parse(StringPiece("18446744073709551616"), uint64_value));
+
+    float float_value = 0;
+    EXPECT_TRUE(dict_field::parse(StringPiece("-170.5"), float_value));
+    EXPECT_EQ(float_value, -170.5f);
+    EXPECT_TRUE(dict_field::parse(StringPiece("0.1"), float_value));
+    EXPECT_EQ(float_value, 0.1f);
+    EXPECT_TRUE(dict_field::parse(StringPiece("1.5e-3"), float_value));
+    EXPECT_EQ(float_value, 1.5e-3f);
+    EXPECT_TRUE(dict_field::parse(StringPiece("3.4028235e38"), float_value));
+    EXPECT_EQ(float_value, std::numeric_limits<float>::max());
+    EXPECT_FALSE(dict_field::parse(StringPiece("1e39"), float_value));
+    EXPECT_FALSE(dict_field::parse(StringPiece("1.5.2"), float_value));
+    EXPECT_FALSE(dict_field::parse(StringPiece("."), float_value));
+}
+
+TEST(GoodCoderTest, NumberParserFallback) {
+    // 不走快速路径的输入: inf/nan, 超长尾数, 超出 float 范围
+    float float_value = 0;
+    EXPECT_TRUE(dict_field::parse(StringPiece("inf"), float_value));
+    EXPECT_EQ(float_value, std::numeric_limits<float>::infinity());
+    EXPECT_TRUE(dict_field::parse(StringPiece("-Infinity"), float_value));
+    EXPECT_EQ(float_value, -std::numeric_limits<float>::infinity());
+    EXPECT_TRUE(dict_field::parse(StringPiece("nan"), float_value));
+    EXPECT_TRUE(std::isnan(float_value));
+    EXPECT_TRUE(dict_field::parse(StringPiece("3.14159265358979323846264338327950288"), float_value));
+    EXPECT_EQ(float_value, 3.14159265358979323846f);
+    EXPECT_TRUE(dict_field::parse(StringPiece("16777217"), float_value));
+    EXPECT_EQ(float_value, 16777216.0f);
+    EXPECT_TRUE(dict_field::parse(StringPiece("1.5e-20"), float_value));
+    EXPECT_EQ(float_value, 1.5e-20f);
+    EXPECT_FALSE(dict_field::parse(StringPiece("-1e39"), float_value));
+    EXPECT_FALSE(dict_field::parse(StringPiece("1e-50"), float_value));
+    EXPECT_FALSE(dict_field::parse(StringPiece("infx"), float_value));
+    EXPECT_FALSE(dict_field::parse(StringPiece(std::string(200, '1')), float_value));
+
+    // 小数点为 ',' 的 locale 下仍然按 '.' 解析
+    std::string old_locale = setlocale(LC_NUMERIC, nullptr);
+    const char* comma_locales[] = {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8", "ru_RU.UTF-8"};
+    for (const char* name : comma_locales) {
+        if (setlocale(LC_NUMERIC, name) != nullptr) {
+            break;
+        }
+    }
+    EXPECT_TRUE(dict_field::parse(StringPiece("1.50000000001"), float_value));
+    EXPECT_EQ(float_value, 1.5f);
+    EXPECT_TRUE(dict_field::parse(StringPiece("1.5e20"), float_value));
+    EXPECT_EQ(float_value, 1.5e20f);
+    setlocale(LC_NUMERIC, old_locale.c_str());
+}
+
+TEST(GoodCoderTest, SplitByChar) {
+    // 覆盖向量化主循环 (跨越多个 16/32 字节块) 和标量尾部, 并与 std::string 版本的 string_splitter 对比
+    std::string inp;
+    for (int i = 0; i < 50; i++) {
+        inp += std::string(i % 7, 'a' + i % 26) + ",";
+        if (i % 5 == 0) inp += ",";
+    }
+    inp += "tail";
+    for (size_t len = 0; len <= inp.size(); len++) {
+        std::string sub = inp.substr(0, len);
+        std::vector<std::string> expected;
+        string_splitter(sub, ",", expected);
+        std::vector<StringPiece> pieces;
+        split_by_char(StringPiece(sub), ',', pieces);
+        ASSERT_EQ(pieces.size(), expected.size()) << "len=" << len;
+        for (size_t i = 0; i < pieces.size(); i++) {
+            ASSERT_EQ(pieces[i].as_string(), expected[i]);
+            ASSERT_TRUE(pieces[i].begin() >= sub.data() && pieces[i].end() <= sub.data() + sub.size());
+        }
+    }
+
+    // 分隔符集合, 以及强制使用每一种指令集的结果都与逐字符扫描一致
+    std::string line;
+    const char kDelims[] = {'\t', ',', '#', ':'};
+    for (int i = 0; i < 80; i++) {
+        line += std::string(i % 5, 'a' + i % 26);
+        line += kDelims[i % 4];
+        if (i % 7 == 0) line += kDelims[(i + 1) % 4];
+    }
+    line += "tail";
+    for (size_t num_delims : {size_t(1), size_t(2), size_t(4)}) {
+        for (size_t len = 0; len <= line.size(); len++) {
+            std::vector<std::string> expected;
+            std::string token;
+            for (size_t i = 0; i < len; i++) {
+                if (memchr(kDelims, line[i], num_delims) != nullptr) {
+                    if (!token.empty()) expected.push_back(token);
+                    token.clear();
+                } else {
+                    token += line[i];
+                }
+            }
+            if (!token.empty()) expected.push_back(token);
+            for (ScanMode mode : {kScanAuto, kScanScalar, kScanSSE2, kScanAVX2}) {
+                std::vector<StringPiece> pieces;
+                split_by_chars(StringPiece(line.data(), len), kDelims, num_delims, pieces, mode);
+                ASSERT_EQ(pieces.size(), expected.size()) << "len=" << len << " mode=" << mode;
+                for (size_t i = 0; i < pieces.size(); i++) {
+                    ASSERT_EQ(pieces[i].as_string(), expected[i]);
+                }
+            }
+        }
+    }
+}
+
+TEST(GoodCoderTest, DictParserStreaming) {
+    for (bool use_mmap : {false, true}) {
+        DictParser dictparser("datas/demo.txt", record_builder_func);
+        dictparser.set_use_mmap(use_mmap);
+        std::vector<std::string> names;
+        int num_batches = 0;
+        ASSERT_TRUE(dictparser.parse_file_streaming(1, [&](const std::vector<std::shared_ptr<Record>>& batch) {
+            num_batches++;
+            for (const auto& record : batch) {
+                names.push_back(std::dynamic_pointer_cast<Field<std::string>>(record->get_field("name"))->data());
+            }
+            return true;
+        }));
+        EXPECT_EQ(num_batches, 2);
+        EXPECT_EQ(names, std::vector<std::string>({"dengyuting", "yinpeng"}));
+        EXPECT_EQ(dictparser.num_line(), 3);
+        EXPECT_EQ(dictparser.num_succ_parsed_line(), 2);
+        EXPECT_TRUE(dictparser.parsed_result().empty());
+    }
+
+    // callback 返回 false 时提前结束
+    DictParser dictparser("datas/demo.txt", record_builder_func);
+    int num_records = 0;
+    ASSERT_TRUE(dictparser.parse_file_streaming(1, [&](const std::vector<std::shared_ptr<Record>>& batch) {
+        num_records += batch.size();
+        return false;
+    }));
+    EXPECT_EQ(num_records, 1);
+    EXPECT_EQ(dictparser.num_line(), 2);
+}
+
+std::shared_ptr<Record> height_builder_func() {
+    std::shared_ptr<Record> record = std::make_shared<Record>();
+    record->add_field(std::make_shared<Field<std::string>>("name"));
+    record->add_field(std::make_shared<Field<uint32_t>>("age"));
+    record->add_field(std::make_shared<Field<float>>("height"));
+    return record;
+}
+
+TEST(GoodCoderTest, DictParserSnapshot) {
+    std::string snapshot_filename = testing::TempDir() + "demo.snapshot";
+    DictParser dictparser("datas/demo.txt", record_builder_func);
+    ASSERT_TRUE(dictparser.parse_file());
+    ASSERT_TRUE(dictparser.save_snapshot(snapshot_filename));
+
+    DictParser loaded_parser("datas/demo.txt", record_builder_func);
+    ASSERT_TRUE(loaded_parser.load_snapshot(snapshot_filename));
+    EXPECT_EQ(loaded_parser.num_line(), 3);
+    EXPECT_EQ(loaded_parser.num_succ_parsed_line(), 2);
+    ASSERT_EQ(loaded_parser.parsed_result().size(), 2);
+    std::shared_ptr<Record> record = loaded_parser.parsed_result()[0];
+    EXPECT_EQ(std::dynamic_pointer_cast<Field<std::string>>(record->get_field("name"))->data(), "dengyuting");
+    EXPECT_EQ(std::dynamic_pointer_cast<Field<int>>(record->get_field("height"))->data(), 183);
+    std::shared_ptr<ArrayField<Field<std::string>>> items =
+        std::dynamic_pointer_cast<ArrayField<Field<std::string>>>(record->get_field("items"));
+    ASSERT_EQ(items->num_fields(), 2);
+    EXPECT_EQ(items->sub_fields_at(1)->data(), "cs");
+    std::shared_ptr<NestedField> money = std::dynamic_pointer_cast<NestedField>(record->get_field("money"));
+    EXPECT_EQ(std::dynamic_pointer_cast<Field<int>>(money->get_field("income"))->data(), 200);
+
+    // header 中的 num_records 损坏时加载失败, 而不是抛出异常
+    std::string corrupt_filename = testing::TempDir() + "corrupt_demo.snapshot";
+    std::ifstream snapshot(snapshot_filename, std::ios::binary);
+    std::string snapshot_content((std::istreambuf_iterator<char>(snapshot)), std::istreambuf_iterator<char>());
+    for (uint64_t num_records : {std::numeric_limits<uint64_t>::max(), uint64_t(1) << 40, uint64_t(3)}) {
+        std::string corrupt_content = snapshot_content;
+        memcpy(&corrupt_content[offsetof(SnapshotHeader, num_records)], &num_records, sizeof(num_records));
+        std::ofstream corrupt(corrupt_filename, std::ios::binary | std::ios::trunc);
+        corrupt << corrupt_content;
+        corrupt.close();
+        DictParser corrupt_parser("datas/demo.txt", record_builder_func);
+        EXPECT_FALSE(corrupt_parser.load_snapshot(corrupt_filename));
+        EXPECT_TRUE(corrupt_parser.parsed_result().empty());
+    }
+    // 第一条 Record 中 items 的元素个数损坏时, 不会先按这个个数扩充子 field.
+    // 偏移: Record 的子 field 个数, name (长度 + "dengyuting"), age, height
+    size_t items_offset = sizeof(SnapshotHeader) + sizeof(uint32_t) * 2 + 10 + sizeof(uint32_t) + sizeof(int);
+    uint32_t num_items = 0;
+    memcpy(&num_items, &snapshot_content[items_offset], sizeof(num_items));
+    ASSERT_EQ(num_items, 2);
+    for (uint32_t corrupt_items : {std::numeric_limits<uint32_t>::max(), uint32_t(1) << 20}) {
+        std::string corrupt_content = snapshot_content;
+        memcpy(&corrupt_content[items_offset], &corrupt_items, sizeof(corrupt_items));
+        std::ofstream corrupt(corrupt_filename, std::ios::binary | std::ios::trunc);
+        corrupt << corrupt_content;
+        corrupt.close();
+        DictParser corrupt_parser("datas/demo.txt", record_builder_func);
+        EXPECT_FALSE(corrupt_parser.load_snapshot(corrupt_filename));
+        EXPECT_TRUE(corrupt_parser.parsed_result().empty());
+    }
+
+    // schema 变化后旧快照必须被拒绝
+    DictParser stale_parser("datas/demo.txt", height_builder_func);
+    EXPECT_FALSE(stale_parser.load_snapshot(snapshot_filename));
+
+    // 自定义类型没有特化 BinaryCodec, 不能写快照
+    DictParser diy_parser("datas/demo2.txt", record_builder_func, "datas/header_file.txt");
+    ASSERT_TRUE(diy_parser.parse_file());
+    EXPECT_FALSE(diy_parser.save_snapshot(snapshot_filename + ".diy"));
+}
+
+TEST(GoodCoderTest, DictParserErrorSummary) {
+    std::string filename = testing::TempDir() + "error_demo.txt";
+    std::ofstream ofile(filename);
+    ofile << "yinpeng\t18\t180\t3:math,cs,physis\t100,fadsf\n"   // 1: invalid_int
+          << "dengyuting\t18\t183\t2:math,cs\t200,150\n"         // 2: ok
+          << "yinpeng\t4294967296\t183\t2:math,cs\t200,150\n"    // 3: invalid_uint32
+          << "yinpeng\t18\t183\t3:math,cs\t200,150\n"            // 4: array_size_mismatch
+          << "yinpeng\t18\t183\n"                                // 5: field_count_mismatch
+          << "yinpeng\t18\t183\t2:math,cs\t200,150\n";           // 6: ok
+    ofile.close();
+
+    for (int num_threads : {1, 3}) {
+        DictParser dictparser(filename, record_builder_func);
+        dictparser.set_num_threads(num_threads);
+        dictparser.set_error_report_mode(DictParser::kAggregateErrors);
+        dictparser.set_max_error_samples(3);
+        ASSERT_TRUE(dictparser.parse_file());
+        EXPECT_EQ(dictparser.num_succ_parsed_line(), 2);
+
+        const ParseErrorSummary& summary = dictparser.error_summary();
+        EXPECT_EQ(summary.num_errors, 4);
+        EXPECT_EQ(summary.counts[kInvalidInt], 1);
+        EXPECT_EQ(summary.counts[kInvalidUint32], 1);
+        EXPECT_EQ(summary.counts[kArraySizeMismatch], 1);
+        EXPECT_EQ(summary.counts[kFieldCountMismatch], 1);
+        EXPECT_EQ(summary.sample_line_numbers, std::vector<uint64_t>({1, 3, 4}));
+    }
+}
+
+namespace {
+struct ArenaDestructorCounter {
+    ~ArenaDestructorCounter() { num_destroyed++; }
+    static int num_destroyed;
+};
+int ArenaDestructorCounter::num_destroyed = 0;
+}  // namespace
+
+TEST(GoodCoderTest, DictParserWithArena) {
+    DictParser dictparser("datas/demo.txt", record_builder_func);
+    dictparser.set_use_arena(true);
+    ASSERT_TRUE(dictparser.parse_file());
+    ASSERT_EQ(dictparser.parsed_result().size(), 2);
+    // Arena 归解析结果所有, Record 是不带引用计数的 shared_ptr
+    const std::shared_ptr<Record>& record = dictparser.parsed_result()[1];
+    EXPECT_EQ(record.use_count(), 0);
+    Field<std::string>* name_field = static_cast<Field<std::string>*>(record->get_field_ptr("name"));
+    EXPECT_EQ(name_field->data(), "yinpeng");
+    ArrayField<Field<std::string>>* items_field =
+        static_cast<ArrayField<Field<std::string>>*>(record->sub_field_ptr_at(3));
+    ASSERT_EQ(items_field->num_fields(), 2);
+    EXPECT_EQ(items_field->sub_field_ptr_at(1)->data(), "cs");
+    EXPECT_EQ(items_field->sub_field_ptr_at(2), nullptr);
+    EXPECT_EQ(record->get_field_ptr("not_exist"), nullptr);
+    // 名字是驻留的, clone 时只拷贝指针
+    EXPECT_EQ(&name_field->name_ref(), &dictparser.record_template()->prototype()->get_field_ptr("name")->name_ref());
+
+    // 解析时新增的数组元素也分配在 Record 的 arena 中, 元素没有名字
+    Arena* arena = record->arena();
+    ASSERT_TRUE(arena != nullptr);
+    EXPECT_EQ(items_field->arena(), arena);
+    EXPECT_TRUE(arena->owns(items_field));
+    for (int i = 0; i < items_field->num_fields(); i++) {
+        Field<std::string>* item = items_field->sub_field_ptr_at(i);
+        EXPECT_TRUE(arena->owns(item));
+        EXPECT_TRUE(item->name_ref().empty());
+    }
+    EXPECT_FALSE(arena->owns(&arena));
+
+    // Arena 析构时只调用登记过的析构函数, 数值类型的 field 直接丢弃
+    static_assert(arena_skip_destructor<Field<int>>::value, "Field<int> should be dropped by the arena");
+    static_assert(!arena_skip_destructor<Field<std::string>>::value, "Field<std::string> owns heap memory");
+    ArenaDestructorCounter::num_destroyed = 0;
+    {
+        Arena local_arena;
+        local_arena.create<ArenaDestructorCounter>();
+        local_arena.create<ArenaDestructorCounter>();
+        EXPECT_EQ(local_arena.create<Field<int>>("id", 3)->data(), 3);
+        EXPECT_EQ(ArenaDestructorCounter::num_destroyed, 0);
+    }
+    EXPECT_EQ(ArenaDestructorCounter::num_destroyed, 2);
+
+    std::shared_ptr<RecordTemplate> record_template = std::make_shared<RecordTemplate>(record_builder_func());
+    std::shared_ptr<Record> heap_record = record_template->new_record();
+    EXPECT_EQ(heap_record->arena(), nullptr);
+    ASSERT_TRUE(heap_record->deserilization("lisi\t20\t170\t12:a,b,c,d,e,f,g,h,i,j,k,l\t1,2"));
+    // 元素没有名字, 但仍然可以用 "sub_field_<i>" 按下标查找
+    ArrayField<Field<std::string>>* heap_items = static_cast<ArrayField<Field<std::string>>*>(heap_record->sub_field_ptr_at(3));
+    EXPECT_EQ(heap_items->get_field_ptr("sub_field_11")->data(), "l");
+    EXPECT_EQ(heap_items->get_field("sub_field_0")->data(), "a");
+    EXPECT_EQ(heap_items->get_field_ptr("sub_field_12"), nullptr);
+    EXPECT_EQ(heap_items->get_field_ptr("sub_field_"), nullptr);
+    EXPECT_EQ(heap_items->get_field_ptr("sub_field_+1"), nullptr);
+}
+
+TEST(GoodCoderTest, DictReloader) {
+    std::string filename = testing::TempDir() + "reload_demo.txt";
+    std::ofstream(filename) << "yinpeng\t18\t180\t3:math,cs,physis\t100,10\n";
+
+    DictReloader reloader([&filename]() { return std::make_shared<DictParser>(filename, record_builder_func); });
+    EXPECT_FALSE(reloader.current());
+    ASSERT_TRUE(reloader.reload());
+    std::shared_ptr<const DictVersion> old_version = reloader.current();
+    ASSERT_EQ(old_version->version(), 1);
+    ASSERT_EQ(old_version->dict().parsed_result().size(), 1);
+
+    std::ofstream(filename) << "dengyuting\t18\t183\t2:math,cs\t200,150\n"
+                            << "yinpeng\t18\t183\t2:math,cs\t200,150\n";
+    ASSERT_TRUE(reloader.reload_async());
+    reloader.wait();
+
+    std::shared_ptr<const DictVersion> new_version = reloader.current();
+    EXPECT_EQ(new_version->version(), 2);
+    EXPECT_EQ(new_version->dict().parsed_result().size(), 2);
+    // 旧版本的读者不受影响
+    ASSERT_EQ(old_version->dict().parsed_result().size(), 1);
+    EXPECT_EQ(std::dynamic_pointer_cast<Field<std::string>>(old_version->dict().parsed_result()[0]->get_field("name"))
+                  ->data(),
+              "yinpeng");
+
+    // 解析失败时保留当前版本
+    remove(filename.c_str());
+    EXPECT_FALSE(reloader.reload());
+    EXPECT_EQ(reloader.current()->version(), 2);
+}
+
+TEST(GoodCoderTest, DictParserIncremental) {
+    std::string filename = testing::TempDir() + "incremental_demo.txt";
+    std::ofstream(filename) << "yinpeng\t18\t180\t3:math,cs,physis\t100,10\n"
+                            << "bad line\n"
+                            << "dengyuting\t18\t183\t2:math,cs";  // 不完整的行
+    DictParser dictparser(filename, record_builder_func);
+    ASSERT_TRUE(dictparser.parse_file_incremental());
+    EXPECT_EQ(dictparser.num_line(), 2);
+    EXPECT_EQ(dictparser.parsed_result().size(), 1);
+
+    // 追加: 补全上次不完整的行, 再追加一行
+    std::ofstream(filename, std::ios::app) << "\t200,150\n"
+                                           << "wangwu\t20\t170\t1:cs\t1,2\n";
+    ASSERT_TRUE(dictparser.parse_file_incremental());
+    EXPECT_EQ(dictparser.num_line(), 4);
+    ASSERT_EQ(dictparser.parsed_result().size(), 3);
+    EXPECT_EQ(std::dynamic_pointer_cast<Field<std::string>>(dictparser.parsed_result()[2]->get_field("name"))->data(),
+              "wangwu");
+
+    // 没有新数据时什么都不做
+    std::shared_ptr<Record> first_record = dictparser.parsed_result()[0];
+    ASSERT_TRUE(dictparser.parse_file_incremental());
+    EXPECT_EQ(dictparser.num_line(), 4);
+    EXPECT_EQ(dictparser.parsed_result()[0], first_record);
+
+    // 文件被重写 (截断) 后全量重建
+    std::ofstream(filename) << "lisi\t30\t175\t1:math\t5,6\n";
+    ASSERT_TRUE(dictparser.parse_file_incremental());
+    EXPECT_EQ(dictparser.num_line(), 1);
+    ASSERT_EQ(dictparser.parsed_result().size(), 1);
+    EXPECT_EQ(std::dynamic_pointer_cast<Field<std::string>>(dictparser.parsed_result()[0]->get_field("name"))->data(),
+              "lisi");
+}
+
+TEST(GoodCoderTest, DictParserKeyIndex) {
+    std::string filename = testing::TempDir() + "key_index_demo.txt";
+    std::ofstream(filename) << "yinpeng\t18\t180\t3:math,cs,physis\t100,10\n"
+                            << "dengyuting\t18\t183\t2:math,cs\t200,150\n"
+                            << "yinpeng\t20\t175\t1:cs\t300,20\n";
+    DictParser dictparser(filename, record_builder_func);
+    ASSERT_TRUE(dictparser.add_key_index("name"));
+    ASSERT_TRUE(dictparser.parse_file());
+    ASSERT_EQ(dictparser.key_index("name")->size(), 3);
+
+    RowRange rows = dictparser.lookup("name", "yinpeng");
+    ASSERT_EQ(rows.size(), 2);
+    EXPECT_EQ(std::vector<size_t>(rows.begin(), rows.end()), std::vector<size_t>({0, 2}));
+    EXPECT_EQ(rows.front(), 0);
+    EXPECT_TRUE(dictparser.lookup("name", "nobody").empty());
+    EXPECT_TRUE(dictparser.lookup("name", 18).empty());
+
+    // 解析之后再加索引, 数值类型和嵌套子 field 也可以作为 key, 数值 key 可以直接传整数
+    ASSERT_TRUE(dictparser.add_key_index("age"));
+    ASSERT_TRUE(dictparser.add_key_index("money.income"));
+    EXPECT_EQ(dictparser.key_index("age")->key_type(), KeyIndex::kUint32Key);
+    EXPECT_EQ(dictparser.lookup("age", "18").size(), 2);
+    EXPECT_EQ(dictparser.lookup("age", 18).size(), 2);
+    EXPECT_EQ(dictparser.lookup("age", uint64_t(20)).front(), 2);
+    EXPECT_TRUE(dictparser.lookup("age", -18).empty());
+    EXPECT_TRUE(dictparser.lookup("age", uint64_t(1) << 32 | 18).empty());
+    EXPECT_TRUE(dictparser.lookup("age", "abc").empty());
+    rows = dictparser.key_index("money.income")->equal_range(200);
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(dictparser.parsed_result()[rows.front()], dictparser.parsed_result()[1]);
+    EXPECT_EQ(dictparser.lookup("money.income", std::string("200")).front(), 1);
+
+    EXPECT_FALSE(dictparser.add_key_index("items"));
+    EXPECT_FALSE(dictparser.add_key_index("money.nothing"));
+    EXPECT_TRUE(dictparser.lookup("height", "180").empty());
+
+    // 并行解析时行号按原始行序
+    dictparser.set_num_threads(3);
+    ASSERT_TRUE(dictparser.parse_file());
+    rows = dictparser.lookup("name", "yinpeng");
+    EXPECT_EQ(std::vector<size_t>(rows.begin(), rows.end()), std::vector<size_t>({0, 2}));
+    EXPECT_EQ(dictparser.key_index("name")->size(), 3);
+}
+
+TEST(GoodCoderTest, FieldHandle) {
+    DictParser dictparser("datas/demo.txt", record_builder_func);
+    ASSERT_TRUE(dictparser.parse_file());
+    const Record &prototype = *dictparser.record_template()->prototype();
+
+    FieldHandle<Field<std::string>> name_handle;
+    FieldHandle<Field<int>> income_handle;
+    FieldHandle<ArrayField<Field<std::string>>> items_handle;
+    ASSERT_TRUE(name_handle.resolve(prototype, "name"));
+    ASSERT_TRUE(income_handle.resolve(prototype, "money.income"));
+    ASSERT_TRUE(items_handle.resolve(prototype, "items"));
+
+    const Record &record = *dictparser.parsed_result()[1];
+    const std::string &name = name_handle.value(record);
+    std::shared_ptr<Record> shared_record = dictparser.parsed_result()[1];
+    EXPECT_EQ(&name, &std::dynamic_pointer_cast<Field<std::string>>(shared_record->get_field("name"))->data());
+    EXPECT_EQ(name, "yinpeng");
+    EXPECT_EQ(income_handle.value(record), 200);
+    const ArrayField<Field<std::string>> &items = items_handle.get(record);
+    ASSERT_EQ(items.num_fields(), 2);
+    EXPECT_EQ(items.sub_field_ptr_at(1)->data(), "cs");
+
+    FieldHandle<Field<int>> bad_handle;
+    EXPECT_FALSE(bad_handle.resolve(prototype, "name"));
+    EXPECT_FALSE(bad_handle.resolve(prototype, "money.nothing"));
+    EXPECT_FALSE(bad_handle.valid());
+}
+
+typedef RecordSchema<Field<std::string>, Field<uint32_t>, Field<int>, ArrayField<Field<std::string>>,
+                     Nested<',', Field<int>, Field<int>>>
+    PeopleSchema;
+
+TEST(GoodCoderTest, StaticSchema) {
+    PeopleSchema::value_type row;
+    ASSERT_TRUE(PeopleSchema::parse("yinpeng\t18\t180\t3:math,cs,physis\t100,10", row));
+    EXPECT_EQ(std::get<0>(row), "yinpeng");
+    EXPECT_EQ(std::get<1>(row), 18);
+    EXPECT_EQ(std::get<2>(row), 180);
+    EXPECT_EQ(std::get<3>(row), std::vector<std::string>({"math", "cs", "physis"}));
+    EXPECT_EQ(std::get<1>(std::get<4>(row)), 10);
+
+    ParseError::reset();
+    EXPECT_FALSE(PeopleSchema::parse("yinpeng\t18\t180\t3:math,cs,physis", row));
+    EXPECT_EQ(ParseError::take(), kFieldCountMismatch);
+    EXPECT_FALSE(PeopleSchema::parse("yinpeng\t18\t180\t3:math,cs,physis\t100,10\textra", row));
+    EXPECT_EQ(ParseError::take(), kFieldCountMismatch);
+    EXPECT_FALSE(PeopleSchema::parse("yinpeng\t18\t180\t3:math,cs\t100,10", row));
+    EXPECT_EQ(ParseError::take(), kArraySizeMismatch);
+
+    // 与运行时 Record 的解析结果一致
+    StaticDictParser<PeopleSchema> static_parser("datas/demo.txt");
+    DictParser dictparser("datas/demo.txt", record_builder_func);
+    ASSERT_TRUE(static_parser.parse_file());
+    ASSERT_TRUE(dictparser.parse_file());
+    EXPECT_EQ(static_parser.num_line(), dictparser.num_line());
+    ASSERT_EQ(static_parser.num_succ_parsed_line(), dictparser.num_succ_parsed_line());
+    EXPECT_EQ(static_parser.error_summary().counts[kInvalidInt], 1);
+    EXPECT_EQ(std::get<0>(static_parser.parsed_result()[1]), "yinpeng");
+    EXPECT_EQ(std::get<0>(std::get<4>(static_parser.parsed_result()[1])), 200);
+}
+
+TEST(GoodCoderTest, ParsePlan) {
+    ParsePlan plan;
+    ASSERT_TRUE(plan.compile(*record_builder_func()));
+    ASSERT_EQ(plan.ops().size(), 7);
+    EXPECT_EQ(plan.ops()[3].code, ParsePlan::kOpStringArray);
+    EXPECT_EQ(plan.ops()[4].code, ParsePlan::kOpNested);
+    EXPECT_EQ(plan.ops()[4].num_child_ops, 2);
+    EXPECT_EQ(plan.ops()[6].slot, 6);
+    // 自定义类型不能编译成 ParsePlan
+    DictParser diy_parser("datas/demo2.txt", record_builder_func, "datas/header_file.txt");
+    EXPECT_FALSE(plan.compile(*diy_parser.record_template()->prototype()));
+
+    std::string header_filename = testing::TempDir() + "plan_header.txt";
+    std::string filename = testing::TempDir() + "plan_demo.txt";
+    std::ofstream(header_filename) << "Field<string>\tField<uint32>\tArrayField<int>\tField<float>\n";
+    std::ofstream(filename) << "yinpeng\t18\t3:1,2,3\t170.5\n"
+                            << "dengyuting\t18\t2:1,2,3\t160\n"  // array_size_mismatch
+                            << "wangwu\t20\t1:7\n"                // field_count_mismatch
+                            << "lisi\t30\t2:4,5\t65.25\n";
+    std::shared_ptr<const ColumnStore> stores[2];
+    for (int use_parse_plan = 0; use_parse_plan < 2; use_parse_plan++) {
+        DictParser dictparser(filename, record_builder_func, header_filename);
+        dictparser.set_columnar(true);
+        dictparser.set_use_parse_plan(use_parse_plan);
+        dictparser.set_error_report_mode(DictParser::kAggregateErrors);
+        ASSERT_TRUE(dictparser.parse_file());
+        EXPECT_EQ(dictparser.num_succ_parsed_line(), 2);
+        EXPECT_EQ(dictparser.error_summary().counts[kArraySizeMismatch], 1);
+        EXPECT_EQ(dictparser.error_summary().counts[kFieldCountMismatch], 1);
+        stores[use_parse_plan] = dictparser.column_store();
+    }
+    for (const auto &store : stores) {
+        ASSERT_EQ(store->num_rows(), 2);
+        EXPECT_EQ(store->typed_column<ValueColumn<std::string>>("0")->at(1), "lisi");
+        EXPECT_EQ(store->typed_column<ArrayColumn<int>>("2")->values().values(), std::vector<int>({1, 2, 3, 4, 5}));
+        EXPECT_EQ(store->typed_column<ValueColumn<float>>("3")->values(), std::vector<float>({170.5, 65.25}));
+    }
+}
+
+TEST(GoodCoderTest, DictLoader) {
+    DictLoader loader(2);
+    loader.add(DictManifestEntry("datas/demo.txt", record_builder_func));
+    loader.add(DictManifestEntry("datas/demo2.txt", "datas/header_file.txt"));
+    loader.add(DictManifestEntry("datas/demo2.txt", "datas/header_file.txt"));
+    loader.add(DictManifestEntry("datas/not_exist.txt", record_builder_func));
+    loader.set_parser_options([](DictParser &parser) {
+        parser.set_use_mmap(true);
+        parser.set_error_report_mode(DictParser::kAggregateErrors);
+    });
+    EXPECT_FALSE(loader.load());
+
+    ASSERT_EQ(loader.stats().size(), 4);
+    const DictLoadStats &stats = loader.stats()[0];
+    EXPECT_TRUE(stats.is_succ);
+    EXPECT_EQ(stats.num_line, 3);
+    EXPECT_EQ(stats.num_succ_parsed_line, 2);
+    EXPECT_GT(stats.num_bytes, 0);
+    EXPECT_GE(stats.elapsed_ms, 0);
+    EXPECT_EQ(loader.stats()[1].num_succ_parsed_line, 3);
+    EXPECT_FALSE(loader.stats()[3].is_succ);
+
+    ASSERT_TRUE(loader.parsers()[1] && loader.parsers()[2]);
+    EXPECT_EQ(loader.parsers()[1]->record_template(), loader.parsers()[2]->record_template());
+    EXPECT_EQ(loader.parsers()[3], nullptr);
+}
+
+TEST(GoodCoderTest, DictParserCompressed) {
+    // 解压后超过一个块, 保证有行跨越块的边界, 最后一行没有换行符
+    std::ifstream demo("datas/demo.txt");
+    std::string demo_content((std::istreambuf_iterator<char>(demo)), std::istreambuf_iterator<char>());
+    std::string content;
+    for (int i = 0; i < 20000; i++) {
+        content += demo_content;
+    }
+    content += "wangwu\t20\t170\t1:cs\t1,2";
+    std::string filename = testing::TempDir() + "compressed_demo.txt.gz";
+    gzFile file = gzopen(filename.c_str(), "wb");
+    ASSERT_TRUE(file != nullptr);
+    ASSERT_EQ(gzwrite(file, content.data(), content.size()), static_cast<int>(content.size()));
+    gzclose(file);
+
+    DictParser dictparser(filename, record_builder_func);
+    dictparser.set_num_threads(4);
+    dictparser.set_error_report_mode(DictParser::kAggregateErrors);
+    ASSERT_TRUE(dictparser.parse_file());
+    EXPECT_EQ(dictparser.num_line(), 60001);
+    ASSERT_EQ(dictparser.num_succ_parsed_line(), 40001);
+    EXPECT_EQ(std::dynamic_pointer_cast<Field<std::string>>(dictparser.parsed_result().back()->get_field("name"))->data(),
+              "wangwu");
+
+    // 流式解析提前结束时, 解压线程也随之结束
+    uint64_t num_records = 0;
+    ASSERT_TRUE(dictparser.parse_file_streaming(100, [&num_records](const std::vector<std::shared_ptr<Record>> &records) {
+        num_records += records.size();
+        return num_records < 1000;
+    }));
+    EXPECT_EQ(num_records, 1000);
+    EXPECT_FALSE(dictparser.parse_file_incremental());
+
+    // 损坏的压缩文件
+    std::string corrupt_filename = testing::TempDir() + "corrupt_demo.txt.gz";
+    std::ofstream(corrupt_filename) << std::string("\x1f\x8b\x08\x00garbage", 11);
+    DictParser corrupt_parser(corrupt_filename, record_builder_func);
+    EXPECT_FALSE(corrupt_parser.parse_file());
+}
+
+TEST(GoodCoderTest, DictParserPipeline) {
+    std::string filename = testing::TempDir() + "pipeline_demo.txt";
+    std::ifstream demo("datas/demo.txt");
+    std::string demo_content((std::istreambuf_iterator<char>(demo)), std::istreambuf_iterator<char>());
+    std::ofstream ofile(filename);
+    for (int i = 0; i < 1000; i++) {
+        ofile << demo_content;
+    }
+    ofile << "wangwu\t20\t170\t1:cs\t1,2";
+    ofile.close();
+
+    DictParser serial_parser(filename, record_builder_func);
+    serial_parser.set_error_report_mode(DictParser::kAggregateErrors);
+    ASSERT_TRUE(serial_parser.parse_file());
+
+    // 很小的块保证有很多块在多个解析线程之间乱序完成
+    DictParser pipeline_parser(filename, record_builder_func);
+    pipeline_parser.set_use_pipeline(true);
+    pipeline_parser.set_pipeline_block_bytes(1000);
+    pipeline_parser.set_num_threads(4);
+    pipeline_parser.set_error_report_mode(DictParser::kAggregateErrors);
+    ASSERT_TRUE(pipeline_parser.parse_file());
+    EXPECT_EQ(pipeline_parser.num_line(), 3001);
+    EXPECT_EQ(pipeline_parser.num_succ_parsed_line(), 2001);
+    EXPECT_EQ(pipeline_parser.error_summary().sample_line_numbers, serial_parser.error_summary().sample_line_numbers);
+    ASSERT_EQ(pipeline_parser.parsed_result().size(), serial_parser.parsed_result().size());
+    for (size_t i = 0; i < serial_parser.parsed_result().size(); i++) {
+        ASSERT_EQ(std::dynamic_pointer_cast<Field<std::string>>(serial_parser.parsed_result()[i]->get_field("name"))->data(),
+                  std::dynamic_pointer_cast<Field<std::string>>(pipeline_parser.parsed_result()[i]->get_field("name"))->data());
+    }
+    const PipelineStats& stats = pipeline_parser.pipeline_stats();
+    EXPECT_GT(stats.num_blocks, 10);
+    EXPECT_EQ(stats.num_bytes, demo_content.size() * 1000 + 22);
+    EXPECT_EQ(stats.num_parse_threads, 4);
+
+    pipeline_parser.set_columnar(true);
+    ASSERT_TRUE(pipeline_parser.parse_file());
+    std::shared_ptr<const ValueColumn<std::string>> names =
+        pipeline_parser.column_store()->typed_column<ValueColumn<std::string>>("name");
+    ASSERT_EQ(names->size(), 2001);
+    EXPECT_EQ(names->at(1999), "yinpeng");
+    EXPECT_EQ(names->at(2000), "wangwu");
+
+    DictParser missing_parser("datas/not_exist.txt", record_builder_func);
+    missing_parser.set_use_pipeline(true);
+    EXPECT_FALSE(missing_parser.parse_file());
+}
+
+TEST(GoodCoderTest, BoundedQueue) {
+    BoundedQueue<std::unique_ptr<int>> queue(3);
+    EXPECT_EQ(queue.capacity(), 4);
+    for (int i = 0; i < 4; i++) {
+        std::unique_ptr<int> value(new int(i));
+        ASSERT_TRUE(queue.try_push(value));
+    }
+    std::unique_ptr<int> value(new int(4));
+    EXPECT_FALSE(queue.try_push(value));
+    EXPECT_EQ(*value, 4);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(*value, i);
+    }
+    EXPECT_FALSE(queue.try_pop(value));
+}
+
+std::shared_ptr<Record> flat_array_builder_func() {
+    std::shared_ptr<Record> record = std::make_shared<Record>();
+    record->add_field(std::make_shared<Field<std::string>>("name"));
+    record->add_field(std::make_shared<Field<uint32_t>>("age"));
+    record->add_field(std::make_shared<Field<int>>("height"));
+    record->add_field(std::make_shared<FlatArrayField<std::string>>("items"));
+    std::shared_ptr<NestedField> nf = std::make_shared<NestedField>("money", ",");
+    nf->add_field(std::make_shared<Field<int>>("income"));
+    nf->add_field(std::make_shared<Field<int>>("expensis"));
+    record->add_field(nf);
+    return record;
+}
+
+TEST(GoodCoderTest, FlatArrayField) {
+    FlatArrayField<uint64_t> prototype("wantedids");
+    std::shared_ptr<FlatArrayField<uint64_t>> ids_field =
+        std::static_pointer_cast<FlatArrayField<uint64_t>>(prototype.clone());
+    ASSERT_TRUE(ids_field->deserilization("3:11111,22222,33333"));
+    ASSERT_EQ(ids_field->size(), 3);
+    EXPECT_EQ(ids_field->at(0), 11111);
+    EXPECT_EQ(ids_field->at(2), 33333);
+    // 解析不会修改原型
+    EXPECT_EQ(prototype.size(), 0);
+    EXPECT_EQ(prototype.num_fields(), 0);
+
+    ParseError::reset();
+    EXPECT_FALSE(ids_field->deserilization("3:11111,22222"));
+    EXPECT_EQ(ParseError::take(), kArraySizeMismatch);
+    EXPECT_FALSE(ids_field->deserilization("2:11111,abc"));
+    EXPECT_EQ(ParseError::take(), kInvalidUint64);
+
+    DictParser dictparser("datas/demo.txt", flat_array_builder_func);
+    dictparser.set_num_threads(2);
+    dictparser.set_use_arena(true);
+    ASSERT_TRUE(dictparser.parse_file());
+    ASSERT_EQ(dictparser.parsed_result().size(), 2);
+    FieldHandle<FlatArrayField<std::string>> items_handle;
+    ASSERT_TRUE(items_handle.resolve(*dictparser.record_template()->prototype(), "items"));
+    const FlatArrayField<std::string>::value_type &items = items_handle.value(*dictparser.parsed_result()[0]);
+    ASSERT_EQ(items.size(), 2);
+    EXPECT_EQ(items[1], "cs");
+
+    std::string snapshot_filename = testing::TempDir() + "flat_array.snapshot";
+    ASSERT_TRUE(dictparser.save_snapshot(snapshot_filename));
+    DictParser loaded_parser("datas/demo.txt", flat_array_builder_func);
+    ASSERT_TRUE(loaded_parser.load_snapshot(snapshot_filename));
+    EXPECT_EQ(items_handle.get(*loaded_parser.parsed_result()[1]).at(0), "math");
+    DictParser array_parser("datas/demo.txt", record_builder_func);
+    EXPECT_FALSE(array_parser.load_snapshot(snapshot_filename));
+
+    // items 的元素个数损坏时加载失败, 不会先按这个个数分配内存.
+    // 偏移: Record 的子 field 个数, name (长度 + "dengyuting"), age, height
+    std::ifstream snapshot(snapshot_filename, std::ios::binary);
+    std::string snapshot_content((std::istreambuf_iterator<char>(snapshot)), std::istreambuf_iterator<char>());
+    size_t items_offset = sizeof(SnapshotHeader) + sizeof(uint32_t) * 2 + 10 + sizeof(uint32_t) + sizeof(int);
+    uint32_t num_items = 0;
+    memcpy(&num_items, &snapshot_content[items_offset], sizeof(num_items));
+    ASSERT_EQ(num_items, 2);
+    num_items = std::numeric_limits<uint32_t>::max();
+    memcpy(&snapshot_content[items_offset], &num_items, sizeof(num_items));
+    std::string corrupt_filename = testing::TempDir() + "corrupt_flat_array.snapshot";
+    std::ofstream(corrupt_filename, std::ios::binary) << snapshot_content;
+    DictParser corrupt_parser("datas/demo.txt", flat_array_builder_func);
+    EXPECT_FALSE(corrupt_parser.load_snapshot(corrupt_filename));
+
+    DictParser columnar_parser("datas/demo.txt", flat_array_builder_func);
+    columnar_parser.set_columnar(true);
+    ASSERT_TRUE(columnar_parser.parse_file());
+    std::shared_ptr<const ArrayColumn<std::string>> items_column =
+        columnar_parser.column_store()->typed_column<ArrayColumn<std::string>>("items");
+    ASSERT_TRUE(items_column != nullptr);
+    EXPECT_EQ(items_column->array_size(0), 2);
+}
+
+std::shared_ptr<Record> interned_builder_func() {
+    std::shared_ptr<Record> record = std::make_shared<Record>();
+    record->add_field(std::make_shared<Field<InternedString>>("name"));
+    record->add_field(std::make_shared<Field<uint32_t>>("age"));
+    record->add_field(std::make_shared<Field<int>>("height"));
+    record->add_field(std::make_shared<FlatArrayField<InternedString>>("items"));
+    std::shared_ptr<NestedField> nf = std::make_shared<NestedField>("money", ",");
+    nf->add_field(std::make_shared<Field<int>>("income"));
+    nf->add_field(std::make_shared<Field<int>>("expensis"));
+    record->add_field(nf);
+    return record;
+}
+
+TEST(GoodCoderTest, StringPool) {
+    StringPool pool;
+    EXPECT_EQ(pool.intern("math"), 0);
+    EXPECT_EQ(pool.intern("cs"), 1);
+    EXPECT_EQ(pool.intern(std::string("math")), 0);
+    EXPECT_EQ(pool.size(), 2);
+    EXPECT_EQ(pool.bytes(), 6);
+    EXPECT_EQ(pool.str(1), "cs");
+    uint32_t id = 0;
+    EXPECT_TRUE(pool.find("math", id));
+    EXPECT_EQ(id, 0);
+    EXPECT_FALSE(pool.find("physis", id));
+
+    Field<InternedString> field("name");
+    {
+        StringPool::Scope scope(&pool);
+        ASSERT_TRUE(field.deserilization("physis"));
+        EXPECT_FALSE(Field<InternedString>("empty").deserilization(""));
+    }
+    EXPECT_EQ(field.data().id, 2);
+    EXPECT_EQ(pool.str(field.data().id), "physis");
+}
+
+TEST(GoodCoderTest, DictParserInternedStrings) {
+    std::string filename = testing::TempDir() + "interned_demo.txt";
+    std::ifstream demo("datas/demo.txt");
+    std::string demo_content((std::istreambuf_iterator<char>(demo)), std::istreambuf_iterator<char>());
+    std::ofstream ofile(filename);
+    for (int i = 0; i < 1000; i++) {
+        ofile << demo_content;
+    }
+    ofile.close();
+
+    DictParser dictparser(filename, interned_builder_func);
+    dictparser.set_num_threads(4);
+    dictparser.set_error_report_mode(DictParser::kAggregateErrors);
+    ASSERT_TRUE(dictparser.parse_file());
+    ASSERT_EQ(dictparser.num_succ_parsed_line(), 2000);
+    std::shared_ptr<StringPool> pool = dictparser.string_pool();
+    // 第一行 income 不合法, 但 name 和 items 已经驻留
+    EXPECT_EQ(pool->size(), 5);
+    FieldHandle<Field<InternedString>> name_handle;
+    ASSERT_TRUE(name_handle.resolve(*dictparser.record_template()->prototype(), "name"));
+    const std::vector<std::shared_ptr<Record>>& records = dictparser.parsed_result();
+    EXPECT_EQ(pool->str(name_handle.value(*records[0]).id), "dengyuting");
+    EXPECT_EQ(pool->str(name_handle.value(*records[1]).id), "yinpeng");
+    EXPECT_EQ(name_handle.value(*records[1]), name_handle.value(*records[1999]));
+    EXPECT_NE(name_handle.value(*records[0]), name_handle.value(*records[1]));
+
+    // 列存模式下只存 id
+    DictParser columnar_parser(filename, interned_builder_func);
+    columnar_parser.set_columnar(true);
+    columnar_parser.set_string_pool(pool);
+    columnar_parser.set_error_report_mode(DictParser::kAggregateErrors);
+    ASSERT_TRUE(columnar_parser.parse_file());
+    std::shared_ptr<const ValueColumn<InternedString>> names =
+        columnar_parser.column_store()->typed_column<ValueColumn<InternedString>>("name");
+    ASSERT_EQ(names->size(), 2000);
+    EXPECT_EQ(names->at(1998), name_handle.value(*records[0]));
+    std::shared_ptr<const ArrayColumn<InternedString>> items =
+        columnar_parser.column_store()->typed_column<ArrayColumn<InternedString>>("items");
+    ASSERT_EQ(items->array_size(0), 2);
+    EXPECT_EQ(pool->str(items->values().at(1).id), "cs");
+    EXPECT_EQ(pool->size(), 5);
+
+    // 快照中存的是字符串内容, 可以加载到另一个池中
+    std::string snapshot_filename = testing::TempDir() + "interned.snapshot";
+    ASSERT_TRUE(dictparser.save_snapshot(snapshot_filename));
+    DictParser loaded_parser("datas/demo.txt", interned_builder_func);
+    std::shared_ptr<StringPool> other_pool = std::make_shared<StringPool>();
+    other_pool->intern("other");
+    loaded_parser.set_string_pool(other_pool);
+    ASSERT_TRUE(loaded_parser.load_snapshot(snapshot_filename));
+    EXPECT_EQ(other_pool->str(name_handle.value(*loaded_parser.parsed_result()[1]).id), "yinpeng");
+}
+
+TEST(GoodCoderTest, StringPoolConcurrent) {
+    // 分片很少, 保证各分片都会多次扩容
+    StringPool pool(4);
+    const int num_threads = 8;
+    const int num_words = 20000;
+    std::vector<std::vector<uint32_t>> ids(num_threads, std::vector<uint32_t>(num_words));
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; t++) {
+        workers.emplace_back([&pool, &ids, t]() {
+            for (int i = 0; i < num_words; i++) {
+                int word = (i + t * 997) % num_words;
+                ids[t][word] = pool.intern("word_" + std::to_string(word));
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    // id 连续, 不重复, 并且所有线程得到的 id 一致
+    ASSERT_EQ(pool.size(), num_words);
+    std::vector<bool> seen(num_words, false);
+    for (int i = 0; i < num_words; i++) {
+        uint32_t id = ids[0][i];
+        ASSERT_LT(id, num_words);
+        EXPECT_FALSE(seen[id]);
+        seen[id] = true;
+        EXPECT_EQ(pool.str(id), "word_" + std::to_string(i));
+        for (int t = 1; t < num_threads; t++) {
+            ASSERT_EQ(ids[t][i], id);
+        }
+    }
+    uint32_t id = 0;
+    EXPECT_TRUE(pool.find("word_123", id));
+    EXPECT_EQ(id, ids[0][123]);
+}
+
+TEST(GoodCoderTest, FieldRegistry) {
+    std::vector<FieldRegistry::Entry> entries;
+    for (int i = 0; i < 100; i++) {
+        entries.push_back(FieldRegistry::Entry{"Type" + std::to_string(i), Field<int>::new_instance});
+    }
+    FieldRegistry registry(entries);
+    for (int i = 0; i < 100; i++) {
+        const FieldRegistry::Entry* entry = registry.find("Type" + std::to_string(i));
+        ASSERT_TRUE(entry != nullptr);
+        EXPECT_EQ(entry->name, "Type" + std::to_string(i));
+    }
+    EXPECT_EQ(registry.find("Type100"), nullptr);
+    EXPECT_EQ(FieldRegistry(std::vector<FieldRegistry::Entry>()).find("Type0"), nullptr);
+
+    // 解析线程查找的同时注册新类型, 已注册的类型始终可见, 新类型发布后立即可见
+    FieldManager* manager = FieldManager::instance();
+    const FieldRegistry* before = manager->registry();
+    std::atomic<bool> stop(false);
+    std::atomic<int> num_missing(0);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&]() {
+            std::vector<std::string> field_names = {"Field<string>", "Field<uint32>", "ArrayField<istring>"};
+            while (!stop) {
+                if (manager->record_builder(field_names)->num_fields() != 3 ||
+                    !manager->get_field_by_name("Field<int>", "height")) {
+                    num_missing++;
+                }
+            }
+        });
+    }
+    for (int i = 0; i < 50; i++) {
+        std::string name = "Field<registry_test_" + std::to_string(i) + ">";
+        manager->register_field(name, Field<int>::new_instance);
+        ASSERT_TRUE(manager->is_registered(name));
+    }
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(num_missing, 0);
+    EXPECT_NE(manager->registry(), before);
+    // 旧表仍然有效
+    EXPECT_TRUE(before->find("Field<int>") != nullptr);
+    EXPECT_EQ(before->find("Field<registry_test_0>"), nullptr);
+}
+
+TEST(GoodCoderTest, DictParserStats) {
+    LatencyHistogram histogram;
+    for (uint64_t i = 1; i <= 1000; i++) {
+        histogram.record(i * 1000);
+    }
+    EXPECT_EQ(histogram.count(), 1000);
+    EXPECT_EQ(histogram.min(), 1000);
+    EXPECT_EQ(histogram.max(), 1000000);
+    EXPECT_NEAR(histogram.percentile(50), 500000, 500000 / 16);
+    EXPECT_NEAR(histogram.percentile(99), 990000, 990000 / 16);
+    EXPECT_EQ(histogram.percentile(100), 1000000);
+
+    // 没有开启统计时不调用分配计数器
+    uint64_t num_allocs = 0;
+    DictParser dictparser("datas/demo.txt", record_builder_func);
+    dictparser.set_allocation_counter([&num_allocs]() { return num_allocs += 5; });
+    ASSERT_TRUE(dictparser.parse_file());
+    EXPECT_EQ(dictparser.parse_stats().num_lines, 0);
+    EXPECT_EQ(num_allocs, 0);
+
+    dictparser.set_collect_stats(true, true);
+    ASSERT_TRUE(dictparser.parse_file());
+    const ParseStats& stats = dictparser.parse_stats();
+    EXPECT_EQ(stats.num_lines, 3);
+    EXPECT_EQ(stats.num_records, 2);
+    EXPECT_EQ(stats.num_bytes, 111);
+    EXPECT_EQ(stats.read_ns.count(), 3);
+    EXPECT_EQ(stats.split_ns.count(), 3);
+    EXPECT_EQ(stats.parse_ns.count(), 3);
+    EXPECT_GE(stats.parse_ns.max(), stats.split_ns.max());
+    EXPECT_TRUE(stats.has_alloc_counter);
+    EXPECT_EQ(stats.num_allocs, 5);
+    EXPECT_DOUBLE_EQ(stats.allocs_per_record(), 2.5);
+    // 第一行 money 中的 income 解析失败, 记到最内层的 Field<int> 上
+    std::map<std::string, uint64_t> errors = stats.field_type_error_counts();
+    ASSERT_EQ(errors.size(), 1);
+    EXPECT_EQ(errors["dict_field::Field<int>"], 1);
+
+    // 多线程和列存模式下各线程的统计合并在一起
+    dictparser.set_num_threads(2);
+    dictparser.set_columnar(true);
+    ASSERT_TRUE(dictparser.parse_file());
+    EXPECT_EQ(dictparser.parse_stats().num_lines, 3);
+    EXPECT_EQ(dictparser.parse_stats().num_records, 2);
+    EXPECT_EQ(dictparser.parse_stats().parse_ns.count(), 3);
+    EXPECT_EQ(dictparser.parse_stats().split_ns.count(), 0);
+    EXPECT_EQ(dictparser.parse_stats().field_type_error_counts().size(), 1);
+}